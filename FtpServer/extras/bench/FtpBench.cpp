@@ -0,0 +1,584 @@
+/*
+ * **********************  FTP server library for Arduino **********************
+ *                  Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Benchmark of the FTP server
+ *
+ * The server runs on the host with a virtual clock, a simulated network and
+ *   a cost model of the storage (see FtpBenchSim.h), so that results are
+ *   reproducible and do not depend on the host.
+ * The bench plays the role of the client: it sends commands, and sends or
+ *   receives data as fast as the simulated link allows.
+ *
+ * Each executable ftpbench_NNNN is built with FTP_BUF_SIZE = NNNN
+ *   (see run_bench.sh to sweep all of them)
+ *
+ * Usage: ftpbench_NNNN [options]
+ *   --net NAME        w5100, w5500, lwip or ideal (default w5500)
+ *   --storage NAME    sd, fastsd, spiflash or ideal (default sd)
+ *   --tx N --rx N     size of socket buffers
+ *   --net-call-us N   cost of each call to the ethernet chip
+ *   --spi-ns N        cost of each byte transfered to the ethernet chip
+ *   --link-mbps N     speed of the link
+ *   --send-wait 0|1   write() waits until data is sent on the link
+ *   --sd-call-us N --sd-lookup-us N --sd-read-us N --sd-write-us N
+ *                     cost of storage calls, names of paths and sector accesses
+ *   --sd-cluster N    size of a cluster in bytes
+ *   --loop-us N       time spent by the sketch between calls to service()
+ *   --ops LIST        comma separated list of retr, stor, allo, list, mlsd, cmds,
+ *                     text, ztext
+ *                     (allo is stor preceded by ALLO with the size of the file,
+ *                      cmds sends one SIZE command per file of the directory
+ *                      without waiting for replies, as scripted clients do,
+ *                      text downloads a CSV log file and ztext the same file
+ *                      in MODE Z. bytes is then the number of bytes on the link.
+ *                      ztext needs FTP_MODE_Z in FTP_BENCH_DEFINES. The time
+ *                      spent by the processor to compress is not modeled)
+ *   --sizes LIST      comma separated list of file sizes (k and M suffixes)
+ *   --entries N       number of files in the directory for list, mlsd and cmds
+ *   --format csv|json
+ *   --no-header       do not print the header line in csv format
+ */
+
+#include "FtpBenchSim.h"
+
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <functional>
+
+static SimCounters      counters;
+static SimNetParams     netParams;
+static SimStorageParams storageParams;
+static uint32_t         loopUs = 10;
+static uint64_t         serviceCalls;
+
+/*******************************************************************************
+**                                                                            **
+**                                FTP CLIENT                                  **
+**                                                                            **
+*******************************************************************************/
+
+class BenchClient
+{
+public:
+  BenchClient( SimSocketDriver & _net, FtpServer & _srv ) : net( _net ), srv( _srv ) {}
+
+  bool login();
+  int  command( const char * cmd, std::function< void() > during = NULL );
+  int  reply( std::function< void() > during = NULL );
+  int  passive();
+  void send( int s, const std::string & str ) { out[ s ] += str; };
+  void sendCommands( const std::string & cmds ) { send( ctrl, cmds ); };
+  void pump();
+
+  std::string lastReply;
+
+private:
+  SimSocketDriver & net;
+  FtpServer & srv;
+  int ctrl;
+  std::string in;
+  std::string out[ 64 ];        // data waiting to be sent, by socket
+};
+
+// Give a turn to the server and send what is waiting
+
+void BenchClient::pump()
+{
+  srv.service();
+  serviceCalls ++;
+  hostClock.advance( loopUs );
+  for( int s = 0; s < 64; s ++ )
+    if( ! out[ s ].empty())
+    {
+      size_t n = net.clientSend( s, (const uint8_t *) out[ s ].data(), out[ s ].size());
+      out[ s ].erase( 0, n );
+    }
+}
+
+// Wait for the last line of a reply and return its code
+// Return -1 if the server does not answer within 10 minutes
+
+int BenchClient::reply( std::function< void() > during )
+{
+  uint64_t tEnd = hostClock.microseconds() + 600000000ULL;
+
+  for( ;; )
+  {
+    size_t eol;
+    net.clientReceive( ctrl, in );
+    while(( eol = in.find( "\r\n" )) != std::string::npos )
+    {
+      std::string line = in.substr( 0, eol );
+      in.erase( 0, eol + 2 );
+      if( line.size() >= 4 && isdigit( line[ 0 ]) && line[ 3 ] == ' ' )
+      {
+        lastReply = line;
+        return atoi( line.c_str());
+      }
+    }
+    if( hostClock.microseconds() > tEnd || ! net.clientConnected( ctrl ))
+      return -1;
+    if( during )
+      during();
+    pump();
+  }
+}
+
+int BenchClient::command( const char * cmd, std::function< void() > during )
+{
+  send( ctrl, std::string( cmd ) + "\r\n" );
+  return reply( during );
+}
+
+bool BenchClient::login()
+{
+  ctrl = net.clientConnect( FTP_CMD_PORT );
+  return ctrl >= 0 && reply() == 220 &&
+         command( "USER " FTP_USER ) == 331 &&
+         command( "PASS " FTP_PASS ) == 230 &&
+         command( "TYPE I" ) == 200;
+}
+
+// Enter passive mode and open data connection. Return socket or -1
+
+int BenchClient::passive()
+{
+  int a[ 6 ];
+  if( command( "PASV" ) != 227 )
+    return -1;
+  const char * p = strchr( lastReply.c_str(), '(' );
+  if( p == NULL ||
+      sscanf( p, "(%d,%d,%d,%d,%d,%d)", a, a + 1, a + 2, a + 3, a + 4, a + 5 ) != 6 )
+    return -1;
+  return net.clientConnect( a[ 4 ] * 256 + a[ 5 ]);
+}
+
+/*******************************************************************************
+**                                                                            **
+**                                SCENARIOS                                   **
+**                                                                            **
+*******************************************************************************/
+
+struct Result
+{
+  bool     ok;
+  uint64_t bytes;
+  uint64_t timeUs;
+};
+
+// Download a file, or a listing of a directory
+
+static Result download( BenchClient & cli, SimSocketDriver & net,
+                        const char * cmd, uint64_t expected, std::string * keep = NULL )
+{
+  Result r = { false, 0, 0 };
+  std::string data;
+  uint64_t t0 = hostClock.microseconds();
+  int d = cli.passive();
+  if( d < 0 )
+    return r;
+
+  auto drain = [ & ]()
+  {
+    r.bytes += net.clientReceive( d, data );
+    if( keep != NULL )
+      * keep += data;
+    data.clear();
+  };
+  int code = cli.command( cmd, drain );
+  if( code == 150 )
+    code = cli.reply( drain );
+  while( net.clientConnected( d ))
+  {
+    drain();
+    cli.pump();
+  }
+  drain();
+  net.clientClose( d );
+  r.timeUs = hostClock.microseconds() - t0;
+  r.ok = code == 226 && ( expected == 0 || r.bytes == expected );
+  return r;
+}
+
+// Return the size of data decompressed from zlib stream z, -1 if it is not valid
+
+static int64_t inflatedSize( const std::string & z )
+{
+  int64_t size = -1;
+#ifdef FTP_MODE_Z
+  FtpInflate unzip;
+  uint8_t b[ 4096 ];
+  size_t i = 0;
+  if( ! unzip.begin())
+    return -1;
+  for( size = 0; ; )
+  {
+    uint16_t room;
+    uint8_t * pin = unzip.input( & room );
+    size_t n = z.size() - i < room ? z.size() - i : room;
+    memcpy( pin, z.data() + i, n );
+    unzip.added( n );
+    i += n;
+    int16_t nb = unzip.read( b, sizeof( b ));
+    if( nb < 0 )
+      break;
+    size += nb;
+    if( nb == 0 && n == 0 )
+      break;
+  }
+  if( ! unzip.done())
+    size = -1;
+  unzip.end();
+#endif
+  return size;
+}
+
+// Download a text file in MODE Z
+
+static Result downloadZ( BenchClient & cli, SimSocketDriver & net,
+                         const char * cmd, uint64_t expected )
+{
+  Result r = { false, 0, 0 };
+  std::string z;
+  if( cli.command( "MODE Z" ) != 200 )
+    return r;
+  r = download( cli, net, cmd, 0, & z );
+  cli.command( "MODE S" );
+  r.ok = r.ok && inflatedSize( z ) == (int64_t) expected;
+  return r;
+}
+
+// Send a SIZE command for each of n files at once and wait for all replies
+
+static Result commands( BenchClient & cli, uint32_t n )
+{
+  Result r = { true, 0, 0 };
+  std::string cmds;
+  uint64_t t0 = hostClock.microseconds();
+  for( uint32_t i = 0; i < n; i ++ )
+  {
+    char cmd[ 64 ];
+    snprintf( cmd, sizeof( cmd ), "SIZE logfile_%05u.csv\r\n", i );
+    cmds += cmd;
+  }
+  r.bytes = cmds.size();
+  cli.sendCommands( cmds );
+  for( uint32_t i = 0; i < n; i ++ )
+    r.ok = cli.reply() == 213 && r.ok;
+  r.timeUs = hostClock.microseconds() - t0;
+  return r;
+}
+
+// Upload a file of size bytes
+
+static Result upload( BenchClient & cli, SimSocketDriver & net,
+                      const char * cmd, const std::string & hostFile, uint64_t size )
+{
+  Result r = { false, 0, 0 };
+  std::string chunk( 65536, 'x' );
+  uint64_t t0 = hostClock.microseconds();
+  int d = cli.passive();
+  if( d < 0 )
+    return r;
+
+  bool closed = false;
+  auto push = [ & ]()
+  {
+    while( r.bytes < size )
+    {
+      size_t n = size - r.bytes < chunk.size() ? size - r.bytes : chunk.size();
+      n = net.clientSend( d, (const uint8_t *) chunk.data(), n );
+      if( n == 0 )
+        return;
+      r.bytes += n;
+    }
+    if( ! closed )
+    {
+      net.clientClose( d );
+      closed = true;
+    }
+  };
+  int code = cli.command( cmd, push );
+  if( code == 150 )
+    code = cli.reply( push );
+  if( ! closed )
+    net.clientClose( d );
+  r.timeUs = hostClock.microseconds() - t0;
+
+  struct stat st;
+  r.ok = code == 226 && stat( hostFile.c_str(), & st ) == 0 && (uint64_t) st.st_size == size;
+  return r;
+}
+
+/*******************************************************************************
+**                                                                            **
+**                                  OUTPUT                                    **
+**                                                                            **
+*******************************************************************************/
+
+static bool json = false;
+static bool firstRow = true;
+
+static void printRow( const char * op, uint64_t size, const Result & r )
+{
+  double kBps = r.timeUs > 0 ? r.bytes * 1000.0 / r.timeUs : 0;
+  if( json )
+  {
+    printf( "%s\n  {\"buf_size\": %d, \"net\": \"%s\", \"storage\": \"%s\", \"op\": \"%s\", "
+            "\"size\": %llu, \"ok\": %s, \"bytes\": %llu, \"time_ms\": %.3f, "
+            "\"kbytes_per_s\": %.1f, \"service_calls\": %llu, \"net_calls\": %llu, "
+            "\"net_writes\": %llu, \"net_reads\": %llu, \"storage_lookups\": %llu, "
+            "\"storage_reads\": %llu, \"storage_writes\": %llu, "
+            "\"sectors_read\": %llu, \"sectors_written\": %llu}",
+            firstRow ? "[" : ",", FTP_BUF_SIZE, netParams.name, storageParams.name, op,
+            (unsigned long long) size, r.ok ? "true" : "false",
+            (unsigned long long) r.bytes, r.timeUs / 1000.0, kBps,
+            (unsigned long long) serviceCalls, (unsigned long long) counters.netCalls,
+            (unsigned long long) counters.netWrites, (unsigned long long) counters.netReads,
+            (unsigned long long) counters.storageLookups,
+            (unsigned long long) counters.storageReads, (unsigned long long) counters.storageWrites,
+            (unsigned long long) counters.sectorsRead, (unsigned long long) counters.sectorsWritten );
+  }
+  else
+    printf( "%d,%s,%s,%s,%llu,%d,%llu,%.3f,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            FTP_BUF_SIZE, netParams.name, storageParams.name, op,
+            (unsigned long long) size, r.ok, (unsigned long long) r.bytes,
+            r.timeUs / 1000.0, kBps,
+            (unsigned long long) serviceCalls, (unsigned long long) counters.netCalls,
+            (unsigned long long) counters.netWrites, (unsigned long long) counters.netReads,
+            (unsigned long long) counters.storageLookups,
+            (unsigned long long) counters.storageReads, (unsigned long long) counters.storageWrites,
+            (unsigned long long) counters.sectorsRead, (unsigned long long) counters.sectorsWritten );
+  firstRow = false;
+}
+
+static const char * csvHeader =
+  "buf_size,net,storage,op,size,ok,bytes,time_ms,kbytes_per_s,service_calls,"
+  "net_calls,net_writes,net_reads,storage_lookups,storage_reads,storage_writes,"
+  "sectors_read,sectors_written\n";
+
+/*******************************************************************************
+**                                                                            **
+**                                   MAIN                                     **
+**                                                                            **
+*******************************************************************************/
+
+static std::vector< std::string > split( const char * list )
+{
+  std::vector< std::string > v;
+  std::string s( list );
+  size_t p;
+  while(( p = s.find( ',' )) != std::string::npos )
+  {
+    v.push_back( s.substr( 0, p ));
+    s.erase( 0, p + 1 );
+  }
+  if( ! s.empty())
+    v.push_back( s );
+  return v;
+}
+
+static uint64_t parseSize( const std::string & s )
+{
+  char * end;
+  uint64_t n = strtoull( s.c_str(), & end, 10 );
+  if( * end == 'k' || * end == 'K' )
+    n <<= 10;
+  else if( * end == 'M' )
+    n <<= 20;
+  return n;
+}
+
+static void makeFile( const std::string & path, uint64_t size )
+{
+  FILE * f = fopen( path.c_str(), "wb" );
+  uint32_t x = 0x12345678;
+  for( uint64_t i = 0; i < size; i ++ )
+  {
+    x = x * 1103515245 + 12345;
+    fputc( x >> 24, f );
+  }
+  fclose( f );
+}
+
+// Text file made of lines of a CSV log
+
+static void makeText( const std::string & path, uint64_t size )
+{
+  FILE * f = fopen( path.c_str(), "wb" );
+  uint32_t x = 0x12345678;
+  char line[ 64 ];
+  for( uint64_t i = 0, n = 0; n < size; i ++ )
+  {
+    x = x * 1103515245 + 12345;
+    int l = snprintf( line, sizeof( line ), "2020-12-08 %02u:%02u:%02u,sensor%u,%u.%02u,%s\n",
+                      unsigned( i / 3600 % 24 ), unsigned( i / 60 % 60 ), unsigned( i % 60 ),
+                      unsigned( i % 4 ), unsigned( 20 + ( x >> 28 )), unsigned(( x >> 16 ) % 100 ),
+                      ( x >> 24 ) % 16 ? "ok" : "alarm" );
+    if( (uint64_t) l > size - n )
+      l = size - n;
+    fwrite( line, 1, l, f );
+    n += l;
+  }
+  fclose( f );
+}
+
+static int removeEntry( const char * path, const struct stat *, int, struct FTW * )
+{
+  return ::remove( path );
+}
+
+static void usage( const char * name )
+{
+  fprintf( stderr, "Usage: %s [--net w5100|w5500|lwip|ideal] [--storage sd|fastsd|spiflash|ideal]\n"
+                   "  [--tx N] [--rx N] [--net-call-us N] [--spi-ns N] [--link-mbps N] [--send-wait 0|1]\n"
+                   "  [--sd-call-us N] [--sd-lookup-us N] [--sd-read-us N] [--sd-write-us N]\n"
+                   "  [--sd-cluster N] [--loop-us N] [--ops retr,stor,allo,list,mlsd,cmds,text,ztext]\n"
+                   "  [--sizes 1k,64k,1M] [--entries N] [--format csv|json] [--no-header]\n", name );
+  exit( 1 );
+}
+
+int main( int argc, char ** argv )
+{
+  const char * ops = "retr,stor,list,mlsd";
+  const char * sizes = "4k,64k,1M";
+  uint32_t entries = 200;
+  bool header = true;
+
+  netParams = * simNetProfile( "w5500" );
+  storageParams = * simStorageProfile( "sd" );
+  for( int i = 1; i < argc; i ++ )
+  {
+    std::string opt = argv[ i ];
+    if( opt == "--no-header" )
+    {
+      header = false;
+      continue;
+    }
+    if( i + 1 >= argc )
+      usage( argv[ 0 ]);
+    const char * val = argv[ ++ i ];
+    uint32_t n = strtoul( val, NULL, 10 );
+    if( opt == "--net" )
+    {
+      if( simNetProfile( val ) == NULL )
+        usage( argv[ 0 ]);
+      netParams = * simNetProfile( val );
+    }
+    else if( opt == "--storage" )
+    {
+      if( simStorageProfile( val ) == NULL )
+        usage( argv[ 0 ]);
+      storageParams = * simStorageProfile( val );
+    }
+    else if( opt == "--tx" )           netParams.txBuf = n;
+    else if( opt == "--rx" )           netParams.rxBuf = n;
+    else if( opt == "--net-call-us" )  netParams.callUs = n;
+    else if( opt == "--spi-ns" )       netParams.spiNsPerByte = n;
+    else if( opt == "--link-mbps" )    netParams.linkMbps = n;
+    else if( opt == "--send-wait" )    netParams.sendWait = n != 0;
+    else if( opt == "--sd-call-us" )   storageParams.callUs = n;
+    else if( opt == "--sd-lookup-us" ) storageParams.lookupUs = n;
+    else if( opt == "--sd-read-us" )   storageParams.readUs = n;
+    else if( opt == "--sd-write-us" )  storageParams.writeUs = n;
+    else if( opt == "--sd-cluster" )   storageParams.clusterSize = n;
+    else if( opt == "--loop-us" )      loopUs = n;
+    else if( opt == "--ops" )          ops = val;
+    else if( opt == "--sizes" )        sizes = val;
+    else if( opt == "--entries" )      entries = n;
+    else if( opt == "--format" )       json = ! strcmp( val, "json" );
+    else
+      usage( argv[ 0 ]);
+  }
+
+  // Prepare the directory published by the server
+  char root[] = "/tmp/ftpbench.XXXXXX";
+  if( mkdtemp( root ) == NULL )
+  {
+    perror( "mkdtemp" );
+    return 1;
+  }
+  std::string rootDir( root );
+  std::vector< std::string > sizeList = split( sizes );
+  for( auto & s : sizeList )
+  {
+    makeFile( rootDir + "/retr_" + s + ".bin", parseSize( s ));
+    makeText( rootDir + "/text_" + s + ".csv", parseSize( s ));
+  }
+  mkdir(( rootDir + "/list" ).c_str(), 0755 );
+  for( uint32_t i = 0; i < entries; i ++ )
+  {
+    char name[ 64 ];
+    snprintf( name, sizeof( name ), "/list/logfile_%05u.csv", i );
+    makeFile( rootDir + name, 100 + i );
+  }
+
+  // Start the server with the simulated backends
+  SimSocketDriver net( netParams, counters );
+  SimStorageModel storage( storageParams, counters );
+  Serial.enable( false );
+  hostClock.setVirtual( true );
+  hostNet.setDriver( & net );
+  hostFs.begin( root );
+  hostFs.setModel( & storage );
+  static FtpServer ftpSrv;
+  ftpSrv.init();
+
+  BenchClient cli( net, ftpSrv );
+  if( ! cli.login())
+  {
+    fprintf( stderr, "Unable to login\n" );
+    return 1;
+  }
+
+  if( header && ! json )
+    fputs( csvHeader, stdout );
+  for( auto & op : split( ops ))
+  {
+    bool isList = op == "list" || op == "mlsd" || op == "cmds";
+    std::vector< std::string > opSizes = isList ? std::vector< std::string >( 1, "" ) : sizeList;
+    for( auto & s : opSizes )
+    {
+      uint64_t size = isList ? entries : parseSize( s );
+      Result r;
+      if( isList )
+        cli.command( "CWD /list" );
+      memset( & counters, 0, sizeof( counters ));
+      serviceCalls = 0;
+      if( op == "retr" )
+        r = download( cli, net, ( "RETR retr_" + s + ".bin" ).c_str(), size );
+      else if( op == "stor" )
+        r = upload( cli, net, ( "STOR stor_" + s + ".bin" ).c_str(),
+                    rootDir + "/stor_" + s + ".bin", size );
+      else if( op == "allo" )
+      {
+        cli.command(( "ALLO " + std::to_string( size )).c_str());
+        r = upload( cli, net, ( "STOR allo_" + s + ".bin" ).c_str(),
+                    rootDir + "/allo_" + s + ".bin", size );
+      }
+      else if( op == "list" )
+        r = download( cli, net, "LIST", 0 );
+      else if( op == "mlsd" )
+        r = download( cli, net, "MLSD", 0 );
+      else if( op == "cmds" )
+        r = commands( cli, size );
+      else if( op == "text" )
+        r = download( cli, net, ( "RETR text_" + s + ".csv" ).c_str(), size );
+      else if( op == "ztext" )
+        r = downloadZ( cli, net, ( "RETR text_" + s + ".csv" ).c_str(), size );
+      else
+        usage( argv[ 0 ]);
+      printRow( op.c_str(), size, r );
+      if( isList )
+        cli.command( "CWD /" );
+    }
+  }
+  if( json )
+    printf( "%s\n", firstRow ? "[]" : "\n]" );
+
+  cli.command( "QUIT" );
+  nftw( root, removeEntry, 16, FTW_DEPTH | FTW_PHYS );
+  return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * **********************  FTP server library for Arduino **********************
+ *                  Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Benchmark of the FTP server
+ *
+ * Simulated backends
+ */
+
+#include "FtpBenchSim.h"
+#include <math.h>
+
+/*******************************************************************************
+ **                                                                            **
+ **                                 PROFILES                                   **
+ **                                                                            **
+ *******************************************************************************/
+
+//   name     txBuf  rxBuf callUs spiNs Mbps sendWait
+static const SimNetParams netProfiles[] = {
+  { "w5100",   2048,  2048,   15, 2000, 100, true  }, // W5100 on SPI, 4 sockets
+  { "w5500",  16384, 16384,   10,  500, 100, true  }, // W5500 with 16 kB socket buffers
+  { "lwip",    5744,  5744,    5,   50,  54, false }, // Esp8266 (lwIP), data copied to stack
+  { "ideal", 1 << 20, 1 << 20, 0,    0, 10000, false }
+};
+
+//   name     callUs lookupUs readUs writeUs cluster
+static const SimStorageParams storageProfiles[] = {
+  { "sd",        50,   2000,   300,   600, 32768 },  // SD card on SPI at 25 MHz
+  { "fastsd",    20,    500,   100,   200, 32768 },  // SD card on SDIO
+  { "spiflash",  30,   1500,   150,  3000,  4096 },  // SPI flash (erase before write)
+  { "ideal",      0,      0,     0,     0, 32768 }
+};
+
+const SimNetParams * simNetProfile( const char * name )
+{
+  for( size_t i = 0; i < sizeof( netProfiles ) / sizeof( netProfiles[ 0 ]); i ++ )
+    if( ! strcmp( name, netProfiles[ i ].name ))
+      return & netProfiles[ i ];
+  return NULL;
+}
+
+const SimStorageParams * simStorageProfile( const char * name )
+{
+  for( size_t i = 0; i < sizeof( storageProfiles ) / sizeof( storageProfiles[ 0 ]); i ++ )
+    if( ! strcmp( name, storageProfiles[ i ].name ))
+      return & storageProfiles[ i ];
+  return NULL;
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                             SIMULATED NETWORK                              **
+ **                                                                            **
+ *******************************************************************************/
+
+int SimSocketDriver::newSocket()
+{
+  Socket so;
+  so.used = true;
+  so.listening = false;
+  so.closedByPeer = false;
+  so.port = 0;
+  so.peer = -1;
+  so.txBusyUntil = 0;
+  so.rxCredit = 0;
+  so.rxTime = hostClock.microseconds();
+  for( size_t i = 0; i < sockets.size(); i ++ )
+    if( ! sockets[ i ].used )
+    {
+      sockets[ i ] = so;
+      return i;
+    }
+  sockets.push_back( so );
+  return sockets.size() - 1;
+}
+
+void SimSocketDriver::reset()
+{
+  sockets.clear();
+}
+
+int SimSocketDriver::listen( IPAddress ip, uint16_t port )
+{
+  int s = newSocket();
+  sockets[ s ].listening = true;
+  sockets[ s ].port = port;
+  return s;
+}
+
+int SimSocketDriver::accept( int s )
+{
+  cnt.netCalls ++;
+  cost( p.callUs );
+  if( sockets[ s ].backlog.empty())
+    return -1;
+  int c = sockets[ s ].backlog.front();
+  sockets[ s ].backlog.pop_front();
+  return c;
+}
+
+int SimSocketDriver::connect( IPAddress ip, uint16_t port )
+{
+  return -1;                    // active mode is not simulated
+}
+
+int SimSocketDriver::available( int s )
+{
+  cnt.netCalls ++;
+  cost( p.callUs );
+  return sockets[ s ].rx.size();
+}
+
+int SimSocketDriver::read( int s, uint8_t * buf, size_t size )
+{
+  Socket & so = sockets[ s ];
+  size_t n = size < so.rx.size() ? size : so.rx.size();
+
+  cnt.netCalls ++;
+  cnt.netReads ++;
+  cost( p.callUs + (uint64_t) n * p.spiNsPerByte / 1000 );
+  if( n == 0 )
+    return -1;
+  std::copy( so.rx.begin(), so.rx.begin() + n, buf );
+  so.rx.erase( so.rx.begin(), so.rx.begin() + n );
+  return n;
+}
+
+// Data is given to the peer at once, but the time needed by the link to
+//   send it limits the space left in the transmit buffer
+
+size_t SimSocketDriver::write( int s, const uint8_t * buf, size_t size )
+{
+  size_t sent = 0;
+
+  cnt.netCalls ++;
+  cnt.netWrites ++;
+  cost( p.callUs );
+  while( sent < size && sockets[ s ].peer >= 0 )
+  {
+    Socket & so = sockets[ s ];
+    size_t chunk = size - sent < p.txBuf ? size - sent : p.txBuf;
+    double now = hostClock.microseconds();
+    double pending = so.txBusyUntil > now ? ( so.txBusyUntil - now ) * bytesPerUs() : 0;
+    if( pending + chunk > p.txBuf )     // wait for space in transmit buffer
+    {
+      cost( ceil(( pending + chunk - p.txBuf ) / bytesPerUs()));
+      now = hostClock.microseconds();
+    }
+    cost((uint64_t) chunk * p.spiNsPerByte / 1000 );
+    so.txBusyUntil = ( so.txBusyUntil > now ? so.txBusyUntil : now ) + chunk / bytesPerUs();
+    Socket & peer = sockets[ so.peer ];
+    peer.rx.insert( peer.rx.end(), buf + sent, buf + sent + chunk );
+    sent += chunk;
+    if( p.sendWait && so.txBusyUntil > hostClock.microseconds())
+      cost( ceil( so.txBusyUntil - hostClock.microseconds()));
+  }
+  return sent;
+}
+
+int SimSocketDriver::availableForWrite( int s )
+{
+  Socket & so = sockets[ s ];
+  double now = hostClock.microseconds();
+  double pending = so.txBusyUntil > now ? ( so.txBusyUntil - now ) * bytesPerUs() : 0;
+
+  cnt.netCalls ++;
+  cost( p.callUs );
+  return pending < p.txBuf ? p.txBuf - (uint32_t) pending : 0;
+}
+
+bool SimSocketDriver::connected( int s )
+{
+  cnt.netCalls ++;
+  cost( p.callUs );
+  return ! sockets[ s ].closedByPeer;
+}
+
+void SimSocketDriver::close( int s )
+{
+  Socket & so = sockets[ s ];
+
+  if( so.peer >= 0 )
+  {
+    sockets[ so.peer ].closedByPeer = true;
+    sockets[ so.peer ].peer = -1;
+  }
+  while( ! so.backlog.empty())
+  {
+    close( so.backlog.front());
+    so.backlog.pop_front();
+  }
+  so.used = false;
+  so.peer = -1;
+  so.rx.clear();
+}
+
+IPAddress SimSocketDriver::remoteIP( int s )
+{
+  return IPAddress( 127, 0, 0, 1 );
+}
+
+// Connect a client to the server listening on port
+
+int SimSocketDriver::clientConnect( uint16_t port )
+{
+  for( size_t l = 0; l < sockets.size(); l ++ )
+    if( sockets[ l ].used && sockets[ l ].listening && sockets[ l ].port == port )
+    {
+      int c = newSocket();
+      int s = newSocket();
+      sockets[ c ].peer = s;
+      sockets[ s ].peer = c;
+      sockets[ l ].backlog.push_back( s );
+      return c;
+    }
+  return -1;
+}
+
+// The client can not send more than what the link can bring since the
+//   last call, nor more than the free space of the receive buffer of the server
+
+size_t SimSocketDriver::clientSend( int s, const uint8_t * buf, size_t size )
+{
+  Socket & so = sockets[ s ];
+  uint64_t now = hostClock.microseconds();
+
+  if( so.peer < 0 )
+    return 0;
+  Socket & peer = sockets[ so.peer ];
+  so.rxCredit += ( now - so.rxTime ) * bytesPerUs();
+  so.rxTime = now;
+  if( so.rxCredit > p.rxBuf )
+    so.rxCredit = p.rxBuf;
+  size_t n = size;
+  if( n > so.rxCredit )
+    n = so.rxCredit;
+  if( n > p.rxBuf - peer.rx.size())
+    n = p.rxBuf - peer.rx.size();
+  peer.rx.insert( peer.rx.end(), buf, buf + n );
+  so.rxCredit -= n;
+  return n;
+}
+
+size_t SimSocketDriver::clientReceive( int s, std::string & str )
+{
+  Socket & so = sockets[ s ];
+  size_t n = so.rx.size();
+
+  str.append( so.rx.begin(), so.rx.end());
+  so.rx.clear();
+  return n;
+}
+
+bool SimSocketDriver::clientConnected( int s )
+{
+  return ! sockets[ s ].closedByPeer || ! sockets[ s ].rx.empty();
+}
+
+void SimSocketDriver::clientClose( int s )
+{
+  close( s );
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                             SIMULATED STORAGE                              **
+ **                                                                            **
+ *******************************************************************************/
+
+// Each name of a path is searched in its directory
+
+void SimStorageModel::lookup( uint16_t names )
+{
+  cnt.storageLookups += names;
+  hostClock.advance( names * p.lookupUs );
+}
+
+void SimStorageModel::read( uint64_t pos, size_t nbyte )
+{
+  uint64_t sectors = ( pos + nbyte - 1 ) / 512 - pos / 512 + 1;
+
+  cnt.storageReads ++;
+  cnt.sectorsRead += sectors;
+  hostClock.advance( p.callUs + sectors * p.readUs );
+}
+
+// Model of the cache of one sector of SdFat: a sector that is partially
+//   written stays in the cache and is written again with the next call.
+// The first sector of a call must be read before, unless it is in the cache.
+// Sectors beyond the end of file (upload) are never read
+
+void SimStorageModel::write( uint64_t pos, size_t nbyte )
+{
+  static uint64_t cachedSector = UINT64_MAX;
+  uint64_t first = pos / 512;
+  uint64_t last = ( pos + nbyte - 1 ) / 512;
+  uint64_t sectors = last - first + 1;
+  uint64_t partial = pos % 512 != 0 && first != cachedSector ? 1 : 0;
+
+  cachedSector = ( pos + nbyte ) % 512 != 0 ? last : UINT64_MAX;
+  cnt.storageWrites ++;
+  cnt.sectorsWritten += sectors;
+  cnt.sectorsRead += partial;
+  hostClock.advance( p.callUs + sectors * p.writeUs + partial * p.readUs );
+}
+
+// Clusters that hold bytes from..to are allocated at once. With FAT32,
+//   a sector of the FAT holds 128 clusters
+
+void SimStorageModel::allocate( uint64_t from, uint64_t to )
+{
+  uint64_t first = ( from + p.clusterSize - 1 ) / p.clusterSize;
+  uint64_t last = ( to + p.clusterSize - 1 ) / p.clusterSize;
+  if( last <= first )
+    return;
+  uint64_t sectors = ( last - 1 ) / 128 - first / 128 + 1;
+  cnt.sectorsRead += sectors;
+  cnt.sectorsWritten += sectors;
+  hostClock.advance( sectors * ( p.readUs + p.writeUs ));
+}
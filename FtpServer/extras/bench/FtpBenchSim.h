@@ -0,0 +1,126 @@
+/*
+ * **********************  FTP server library for Arduino **********************
+ *                  Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Benchmark of the FTP server
+ *
+ * Simulated backends: an in-memory network that costs the time an ethernet
+ *   chip would take, and a cost model of a memory card.
+ *   All costs are added to the virtual clock of the host.
+ */
+
+#ifndef FTP_BENCH_SIM_H
+#define FTP_BENCH_SIM_H
+
+#include <FtpServer.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+// Parameters of the simulated network
+
+struct SimNetParams
+{
+  const char * name;
+  uint32_t txBuf;               // size of transmit buffer of a socket
+  uint32_t rxBuf;               // size of receive buffer of a socket
+  uint32_t callUs;              // cost of any call to the chip
+  uint32_t spiNsPerByte;        // cost of the transfer of a byte between MCU and chip
+  uint32_t linkMbps;            // speed of the link
+  bool     sendWait;            // write() wait until data is sent, like Ethernet library
+};
+
+// Parameters of the simulated storage
+
+struct SimStorageParams
+{
+  const char * name;
+  uint32_t callUs;              // cost of any read or write call
+  uint32_t lookupUs;            // cost of the lookup of one name of a path
+  uint32_t readUs;              // cost of the read of a 512 bytes sector
+  uint32_t writeUs;             // cost of the write of a 512 bytes sector
+  uint32_t clusterSize;         // size of a cluster in bytes
+};
+
+const SimNetParams * simNetProfile( const char * name );
+const SimStorageParams * simStorageProfile( const char * name );
+
+// Counters of the simulation
+
+struct SimCounters
+{
+  uint64_t netCalls, netWrites, netReads;
+  uint64_t storageLookups, storageReads, storageWrites, sectorsRead, sectorsWritten;
+};
+
+// In-memory network
+// Sockets used by the server are driven through HostSocketDriver and pay
+//   the costs of the chip. The bench plays the client with clientXxx()
+//   functions, which cost nothing.
+
+class SimSocketDriver : public HostSocketDriver
+{
+public:
+  SimSocketDriver( const SimNetParams & _p, SimCounters & _cnt ) : p( _p ), cnt( _cnt ) {}
+
+  int       listen( IPAddress ip, uint16_t port );
+  int       accept( int s );
+  int       connect( IPAddress ip, uint16_t port );
+  int       available( int s );
+  int       read( int s, uint8_t * buf, size_t size );
+  size_t    write( int s, const uint8_t * buf, size_t size );
+  int       availableForWrite( int s );
+  bool      connected( int s );
+  void      close( int s );
+  IPAddress remoteIP( int s );
+
+  int       clientConnect( uint16_t port );
+  size_t    clientSend( int s, const uint8_t * buf, size_t size );
+  size_t    clientReceive( int s, std::string & str );
+  bool      clientConnected( int s );
+  void      clientClose( int s );
+  void      reset();
+
+private:
+  struct Socket
+  {
+    bool     used, listening, closedByPeer;
+    uint16_t port;
+    int      peer;
+    std::deque< uint8_t > rx;   // data received, waiting to be read
+    std::deque< int > backlog;  // connections waiting for accept()
+    double   txBusyUntil;       // time when the link will have sent all data
+    double   rxCredit;          // bytes the link could have brought since rxTime
+    uint64_t rxTime;
+  };
+
+  void   cost( uint64_t us ) { hostClock.advance( us ); }
+  int    newSocket();
+  double bytesPerUs() { return p.linkMbps / 8.0; }
+
+  const SimNetParams & p;
+  SimCounters & cnt;
+  std::vector< Socket > sockets;
+};
+
+// Cost model of a memory card
+// Partial sector writes cost a read-modify-write of the sector
+// Allocation of clusters costs a read-modify-write of the sectors of the
+//   FAT that hold them
+
+class SimStorageModel : public HostStorageModel
+{
+public:
+  SimStorageModel( const SimStorageParams & _p, SimCounters & _cnt ) : p( _p ), cnt( _cnt ) {}
+
+  void lookup( uint16_t names );
+  void read( uint64_t pos, size_t nbyte );
+  void write( uint64_t pos, size_t nbyte );
+  void allocate( uint64_t from, uint64_t to );
+
+private:
+  const SimStorageParams & p;
+  SimCounters & cnt;
+};
+
+#endif // FTP_BENCH_SIM_H
@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Run the benchmark for all values of FTP_BUF_SIZE, all network profiles and
+#   all storage profiles, and print the results as one CSV table
+#
+# Usage: run_bench.sh BUILD_DIR [options of ftpbench]
+#   BUILD_DIR is the directory where cmake built the project
+#   Additional options are given to each run (see FtpBench.cpp), for example:
+#     run_bench.sh build --sizes 64k,1M --ops retr,stor > results.csv
+
+BUILD=${1:-build}
+[ $# -gt 0 ] && shift
+NETS=${FTP_BENCH_NETS:-"w5100 w5500 lwip"}
+STORAGES=${FTP_BENCH_STORAGES:-"sd fastsd"}
+
+header=""
+for bench in $( ls "$BUILD"/FtpServer/extras/bench/ftpbench_* | sort -V ); do
+  for net in $NETS; do
+    for storage in $STORAGES; do
+      "$bench" --net $net --storage $storage $header "$@" || exit 1
+      header="--no-header"
+    done
+  done
+done
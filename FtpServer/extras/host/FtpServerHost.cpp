@@ -0,0 +1,110 @@
+/*
+ * **********************  FTP server library for Arduino **********************
+ *                  Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * This program runs the FTP server library on a POSIX system, so that it can
+ *   be tested, profiled or benchmarked with usual tools (perf, sanitizers,
+ *   any FTP client, ...)
+ *
+ * Usage: ftpserver [-r root] [-i ip] [-p port] [-d pasvport]
+ *                  [-u user] [-w password] [-c] [-q]
+ *   -r  directory of the host published by the server (default: current dir)
+ *   -i  IP address of the server (default: 127.0.0.1)
+ *   -p  command port (default: 2121)
+ *   -d  first data port in passive mode (default: 55600)
+ *   -u  -w  user name and password (default: arduino test)
+ *   -c  names of files ignore case, as on FAT
+ *   -q  do not print debugging info
+ */
+
+#include <FtpServer.h>
+
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#if FTP_RAM_FS_SIZE > 0
+// Date and time of files written in RAM, from the clock of the host
+void dateTime( uint16_t * date, uint16_t * time )
+{
+  time_t t = ::time( NULL );
+  struct tm tm;
+  localtime_r( & t, & tm );
+  * date = ( tm.tm_year - 80 ) << 9 | ( tm.tm_mon + 1 ) << 5 | tm.tm_mday;
+  * time = tm.tm_hour << 11 | tm.tm_min << 5 | tm.tm_sec >> 1;
+}
+#endif
+
+/*******************************************************************************
+**                                                                            **
+**                               INITIALISATION                               **
+**                                                                            **
+*******************************************************************************/
+
+int main( int argc, char ** argv )
+{
+  const char * root = ".";
+  const char * user = FTP_USER;
+  const char * pass = FTP_PASS;
+  struct in_addr ip;
+  uint16_t cmdPort = 2121;
+  uint16_t pasvPort = FTP_DATA_PORT_PASV;
+  int opt;
+
+  inet_aton( "127.0.0.1", & ip );
+  while(( opt = getopt( argc, argv, "r:i:p:d:u:w:cq" )) != -1 )
+    switch( opt )
+    {
+      case 'r': root = optarg; break;
+      case 'i':
+        if( ! inet_aton( optarg, & ip ))
+        {
+          fprintf( stderr, "Invalid IP address %s\n", optarg );
+          return 1;
+        }
+        break;
+      case 'p': cmdPort = atoi( optarg ); break;
+      case 'd': pasvPort = atoi( optarg ); break;
+      case 'u': user = optarg; break;
+      case 'w': pass = optarg; break;
+      case 'c': hostFs.ignoreCase( true ); break;
+      case 'q': Serial.enable( false ); break;
+      default:
+        fprintf( stderr, "Usage: %s [-r root] [-i ip] [-p port] [-d pasvport] "
+                         "[-u user] [-w password] [-c] [-q]\n", argv[ 0 ] );
+        return 1;
+    }
+  setvbuf( stdout, NULL, _IOLBF, 0 );
+
+  // Mount the directory of the host
+  if( ! hostFs.begin( root ))
+  {
+    fprintf( stderr, "Unable to open directory %s\n", root );
+    return 1;
+  }
+  hostNet.begin( IPAddress((uint32_t) ip.s_addr ));
+
+  // Initialize the FTP server
+  static FtpServer ftpSrv( cmdPort, pasvPort );
+  #if FTP_RAM_FS_SIZE > 0
+    FtpRamFs::dateTimeCallback( dateTime );
+  #endif
+  ftpSrv.init();
+  ftpSrv.credentials( user, pass );
+
+/*******************************************************************************
+**                                                                            **
+**                                 MAIN LOOP                                  **
+**                                                                            **
+*******************************************************************************/
+
+  for( ;; )
+  {
+    // Sleep a little when no client is being served
+    if(( ftpSrv.service() & 0x07 ) <= FTP_Client )
+      usleep( 1000 );
+  }
+  return 0;
+}
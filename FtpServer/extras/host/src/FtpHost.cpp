@@ -0,0 +1,73 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * Functions of the Arduino core
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpHost.h"
+
+#include <time.h>
+#include <unistd.h>
+
+HostSerial Serial;
+HostClock  hostClock;
+
+uint64_t HostClock::microseconds()
+{
+  static struct timespec t0 = { 0, 0 };
+  struct timespec t;
+
+  if( virt )
+    return now;
+  clock_gettime( CLOCK_MONOTONIC, & t );
+  if( t0.tv_sec == 0 && t0.tv_nsec == 0 )
+    t0 = t;
+  return ( t.tv_sec - t0.tv_sec ) * 1000000ULL + ( t.tv_nsec - t0.tv_nsec ) / 1000;
+}
+
+uint32_t millis()
+{
+  return hostClock.microseconds() / 1000;
+}
+
+uint32_t micros()
+{
+  return hostClock.microseconds();
+}
+
+void delay( uint32_t ms )
+{
+  if( hostClock.isVirtual())
+    hostClock.advance( 1000ULL * ms );
+  else
+    usleep( ms * 1000 );
+}
+
+size_t HostSerial::write( uint8_t c )
+{
+  return write( & c, 1 );
+}
+
+size_t HostSerial::write( const uint8_t * buf, size_t size )
+{
+  if( enabled )
+    fwrite( buf, 1, size, stdout );
+  return size;
+}
@@ -0,0 +1,194 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * This file replaces the parts of the Arduino core, of the Ethernet library
+ *   and of SdFat (sdios.h) that are used by FtpServer, so that FtpServer.cpp
+ *   can be compiled without modification on a POSIX system.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FTP_HOST_H
+#define FTP_HOST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/*******************************************************************************
+ **                                                                            **
+ **                             ARDUINO CORE                                   **
+ **                                                                            **
+ *******************************************************************************/
+
+class __FlashStringHelper;
+#define F( s )   ( reinterpret_cast< const __FlashStringHelper * >( s ))
+#define PSTR( s )  ( s )
+#define strcmp_P( a, b )  strcmp( a, b )
+#define strcmp_PF( a, b ) strcmp( a, b )
+
+uint32_t millis();
+uint32_t micros();
+void     delay( uint32_t ms );
+
+// Clock of the host
+// In virtual mode, time only moves when advance() or delay() are called,
+//   so that simulations (see extras/bench) are reproducible
+
+class HostClock
+{
+public:
+  HostClock() : virt( false ), now( 0 ) {}
+  void     setVirtual( bool on ) { virt = on; now = 0; }
+  bool     isVirtual() { return virt; }
+  void     advance( uint64_t us ) { now += us; }
+  uint64_t microseconds();
+
+private:
+  bool     virt;
+  uint64_t now;                 // virtual time in microseconds
+};
+
+extern HostClock hostClock;
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write( uint8_t c ) = 0;
+  virtual size_t write( const uint8_t * buf, size_t size )
+  {
+    size_t n = 0;
+    while( size -- > 0 && write( * buf ++ ) == 1 )
+      n ++;
+    return n;
+  }
+  size_t write( const char * str ) { return write((const uint8_t *) str, strlen( str )); }
+};
+
+class IPAddress
+{
+public:
+  IPAddress() { memset( bytes, 0, 4 ); }
+  IPAddress( uint8_t a, uint8_t b, uint8_t c, uint8_t d )
+    { bytes[ 0 ] = a; bytes[ 1 ] = b; bytes[ 2 ] = c; bytes[ 3 ] = d; }
+  IPAddress( uint32_t address ) { memcpy( bytes, & address, 4 ); }
+
+  operator uint32_t() const { uint32_t a; memcpy( & a, bytes, 4 ); return a; }
+  bool operator==( const IPAddress & addr ) const { return ! memcmp( bytes, addr.bytes, 4 ); }
+  uint8_t   operator[]( int index ) const { return bytes[ index ]; }
+  uint8_t & operator[]( int index ) { return bytes[ index ]; }
+
+private:
+  uint8_t bytes[ 4 ];
+};
+
+// Console of the host. Output can be disabled with Serial.enable( false )
+
+class HostSerial : public Print
+{
+public:
+  HostSerial() : enabled( true ) {}
+  void   begin( unsigned long ) {}
+  void   enable( bool on ) { enabled = on; }
+  size_t write( uint8_t c );
+  size_t write( const uint8_t * buf, size_t size );
+  using  Print::write;
+
+private:
+  bool enabled;
+};
+
+extern HostSerial Serial;
+
+/*******************************************************************************
+ **                                                                            **
+ **                  OUTPUT STREAM (subset of SdFat sdios.h)                   **
+ **                                                                            **
+ *******************************************************************************/
+
+class ArduinoOutStream
+{
+public:
+  ArduinoOutStream( Print & pr ) : pr( & pr ), base( 10 ) {}
+
+  ArduinoOutStream & operator<<( ArduinoOutStream & ( * pf )( ArduinoOutStream & ))
+    { return pf( * this ); }
+  ArduinoOutStream & operator<<( const __FlashStringHelper * s )
+    { return * this << reinterpret_cast< const char * >( s ); }
+  ArduinoOutStream & operator<<( const char * s )
+    { while( * s ) put( * s ++ ); return * this; }
+  ArduinoOutStream & operator<<( char * s ) { return * this << (const char *) s; }
+  ArduinoOutStream & operator<<( char c ) { put( c ); return * this; }
+  ArduinoOutStream & operator<<( signed char c ) { put( c ); return * this; }
+  ArduinoOutStream & operator<<( unsigned char c ) { put( c ); return * this; }
+  ArduinoOutStream & operator<<( short n ) { return num( n ); }
+  ArduinoOutStream & operator<<( unsigned short n ) { return unum( n ); }
+  ArduinoOutStream & operator<<( int n ) { return num( n ); }
+  ArduinoOutStream & operator<<( unsigned int n ) { return unum( n ); }
+  ArduinoOutStream & operator<<( long n ) { return num( n ); }
+  ArduinoOutStream & operator<<( unsigned long n ) { return unum( n ); }
+  ArduinoOutStream & operator<<( long long n ) { return num( n ); }
+  ArduinoOutStream & operator<<( unsigned long long n ) { return unum( n ); }
+
+  void put( char c )
+  {
+    if( c == '\n' )
+      pr->write( '\r' );
+    pr->write( c );
+  }
+  void setBase( uint8_t b ) { base = b; }
+
+private:
+  ArduinoOutStream & num( long long n )
+  {
+    if( n < 0 && base == 10 )
+    {
+      put( '-' );
+      return unum( - (unsigned long long) n );
+    }
+    return unum((unsigned long long) n );
+  }
+  ArduinoOutStream & unum( unsigned long long n )
+  {
+    char str[ 24 ];
+    char * p = str + sizeof( str );
+    * -- p = 0;
+    do
+    {
+      uint8_t d = n % base;
+      * -- p = d < 10 ? '0' + d : 'A' + d - 10;
+      n /= base;
+    } while( n > 0 );
+    return * this << (const char *) p;
+  }
+
+  Print * pr;
+  uint8_t base;
+};
+
+inline ArduinoOutStream & endl( ArduinoOutStream & s ) { s.put( '\n' ); return s; }
+inline ArduinoOutStream & hex( ArduinoOutStream & s ) { s.setBase( 16 ); return s; }
+inline ArduinoOutStream & dec( ArduinoOutStream & s ) { s.setBase( 10 ); return s; }
+
+#include "FtpHostNet.h"
+#include "FtpHostFs.h"
+
+#endif // FTP_HOST_H
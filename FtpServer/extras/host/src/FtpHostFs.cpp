@@ -0,0 +1,345 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * Files system adapter
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpHost.h"
+
+#include <time.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+HostFs hostFs;
+
+// Number of names of path, that are looked up one by one by a FAT files system
+
+static uint16_t pathNames( const char * path )
+{
+  uint16_t n = 0;
+  for( const char * p = path; * p != 0; p ++ )
+    if( * p != '/' && ( p == path || * ( p - 1 ) == '/' ))
+      n ++;
+  return n > 0 ? n : 1;
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                               FILES SYSTEM                                 **
+ **                                                                            **
+ *******************************************************************************/
+
+bool HostFs::begin( const char * _root )
+{
+  struct stat st;
+
+  root = _root;
+  // FtpServer always give absolute paths, so root must not end with '/'
+  while( root.size() > 1 && root[ root.size() - 1 ] == '/' )
+    root.erase( root.size() - 1 );
+  if( root == "/" )
+    root.clear();
+  return stat( _root, & st ) == 0 && S_ISDIR( st.st_mode );
+}
+
+bool HostFs::exists( const char * path )
+{
+  struct stat st;
+  model->lookup( pathNames( path ));
+  return stat( hostPath( path ).c_str(), & st ) == 0;
+}
+
+bool HostFs::remove( const char * path )
+{
+  model->lookup( pathNames( path ));
+  return unlink( hostPath( path ).c_str()) == 0;
+}
+
+bool HostFs::mkdir( const char * path )
+{
+  model->lookup( pathNames( path ));
+  return ::mkdir( hostPath( path ).c_str(), 0755 ) == 0;
+}
+
+bool HostFs::rmdir( const char * path )
+{
+  model->lookup( pathNames( path ));
+  return ::rmdir( hostPath( path ).c_str()) == 0;
+}
+
+bool HostFs::rename( const char * path, const char * newpath )
+{
+  model->lookup( pathNames( path ) + pathNames( newpath ));
+  return ::rename( hostPath( path ).c_str(), hostPath( newpath ).c_str()) == 0;
+}
+
+// Path in the host of path, from directory dir of the host. When case is
+//   ignored, each name of path is replaced by the entry of its directory
+//   that has the same name without case, if there is one
+
+std::string HostFs::hostPath( const std::string & dir, const char * path )
+{
+  if( ! noCase )
+    return dir + path;
+  std::string hpath = dir;
+  while( * path != 0 )
+  {
+    const char * end = path;
+    while( * end != 0 && * end != '/' )
+      end ++;
+    std::string name( path, end - path );
+    struct stat st;
+    DIR * d;
+    if( ! name.empty() && stat(( hpath + name ).c_str(), & st ) != 0 &&
+        ( d = opendir( hpath.empty() ? "." : hpath.c_str())) != NULL )
+    {
+      struct dirent * entry;
+      while(( entry = readdir( d )) != NULL )
+        if( ! strcasecmp( entry->d_name, name.c_str()))
+        {
+          name = entry->d_name;
+          break;
+        }
+      closedir( d );
+    }
+    hpath += name;
+    if( * end == '/' )
+      hpath += * end ++;
+    path = end;
+  }
+  return hpath;
+}
+
+uint32_t HostFs::capacity()
+{
+  struct statvfs vfs;
+  if( statvfs( hostPath( "/" ).c_str(), & vfs ) < 0 )
+    return 0;
+  return (uint64_t) vfs.f_blocks * vfs.f_frsize >> 10;
+}
+
+uint32_t HostFs::free()
+{
+  struct statvfs vfs;
+  if( statvfs( hostPath( "/" ).c_str(), & vfs ) < 0 )
+    return 0;
+  return (uint64_t) vfs.f_bavail * vfs.f_frsize >> 10;
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                                   FILES                                    **
+ **                                                                            **
+ *******************************************************************************/
+
+bool HostFile::open( const char * path, int oflag )
+{
+  const char * pname = strrchr( path, '/' );
+  name = pname == NULL ? path : pname + 1;
+  return openHost( hostFs.hostPath( path ), oflag, pathNames( path ));
+}
+
+// Open path relative to directory dirFile
+
+bool HostFile::open( HostFile * dirFile, const char * path, int oflag )
+{
+  if( dirFile->dir == NULL )
+    return false;
+  const char * pname = strrchr( path, '/' );
+  name = pname == NULL ? path : pname + 1;
+  return openHost( hostFs.hostPath( dirFile->hpath + "/", path ), oflag, pathNames( path ));
+}
+
+bool HostFile::openHost( const std::string & path, int oflag, uint16_t names )
+{
+  struct stat st;
+
+  close();
+  hostFs.getModel()->lookup( names );
+  if( stat( path.c_str(), & st ) == 0 && S_ISDIR( st.st_mode ))
+  {
+    if(( oflag & O_ACCMODE ) != O_RDONLY )
+      return false;
+    dir = opendir( path.c_str());
+  }
+  else
+    fd = ::open( path.c_str(), oflag, 0644 );
+  allocated = fd >= 0 && fstat( fd, & st ) == 0 ? st.st_size : 0;
+  hpath = path;
+  return isOpen();
+}
+
+// Open next file of directory dirFile
+
+bool HostFile::openNext( HostFile * dirFile, int oflag )
+{
+  struct dirent * entry;
+
+  if( dirFile->dir == NULL )
+    return false;
+  while(( entry = readdir( dirFile->dir )) != NULL )
+  {
+    if( ! strcmp( entry->d_name, "." ) || ! strcmp( entry->d_name, ".." ))
+      continue;
+    if( openHost( dirFile->hpath + "/" + entry->d_name, oflag, 1 ))
+    {
+      name = entry->d_name;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HostFile::close()
+{
+  bool ok = true;
+
+  if( fd >= 0 )
+    ok = ::close( fd ) == 0;
+  if( dir != NULL )
+    closedir( dir );
+  fd = -1;
+  dir = NULL;
+  return ok;
+}
+
+int HostFile::read( void * buf, size_t nbyte )
+{
+  if( fd < 0 )
+    return -1;
+  int n = ::read( fd, buf, nbyte );
+  if( n > 0 )
+    hostFs.getModel()->read( lseek( fd, 0, SEEK_CUR ) - n, n );
+  return n;
+}
+
+void HostFile::readBy( size_t nbyte )
+{
+  hostFs.getModel()->read( lseek( fd, 0, SEEK_CUR ) - nbyte, nbyte );
+}
+
+size_t HostFile::write( const void * buf, size_t nbyte )
+{
+  if( fd < 0 )
+    return 0;
+  ssize_t n = ::write( fd, buf, nbyte );
+  if( n > 0 )
+  {
+    uint64_t end = lseek( fd, 0, SEEK_CUR );
+    if( end > allocated )
+    {
+      hostFs.getModel()->allocate( allocated, end );
+      allocated = end;
+    }
+    hostFs.getModel()->write( end - n, n );
+  }
+  return n < 0 ? 0 : n;
+}
+
+// Give length bytes of space to an empty file, without changing its size,
+//   like SdFat preAllocate()
+
+bool HostFile::preAllocate( uint64_t length )
+{
+  if( fd < 0 || fileSize() != 0 ||
+      fallocate( fd, FALLOC_FL_KEEP_SIZE, 0, length ) != 0 )
+    return false;
+  hostFs.getModel()->allocate( 0, length );
+  allocated = length;
+  return true;
+}
+
+// Truncate the file at current position and release space given after it
+
+bool HostFile::truncate()
+{
+  if( fd < 0 )
+    return false;
+  off_t pos = lseek( fd, 0, SEEK_CUR );
+  if( ftruncate( fd, pos ) != 0 )
+    return false;
+  allocated = pos;
+  return true;
+}
+
+uint64_t HostFile::fileSize()
+{
+  struct stat st;
+  if( fd < 0 || fstat( fd, & st ) < 0 )
+    return 0;
+  return st.st_size;
+}
+
+bool HostFile::seekSet( uint64_t pos )
+{
+  return fd >= 0 && lseek( fd, pos, SEEK_SET ) == (off_t) pos;
+}
+
+size_t HostFile::printName( Print * pr )
+{
+  return pr->write( name.c_str());
+}
+
+// Return date and time of last modification in FAT format
+
+bool HostFile::getModifyDateTime( uint16_t * pdate, uint16_t * ptime )
+{
+  struct stat st;
+  struct tm tm;
+
+  if( ! isOpen() || stat( hpath.c_str(), & st ) < 0 ||
+      localtime_r( & st.st_mtime, & tm ) == NULL )
+    return false;
+  * pdate = ( tm.tm_year - 80 ) << 9 | ( tm.tm_mon + 1 ) << 5 | tm.tm_mday;
+  * ptime = tm.tm_hour << 11 | tm.tm_min << 5 | tm.tm_sec >> 1;
+  return true;
+}
+
+bool HostFile::timestamp( uint8_t flags, uint16_t year, uint8_t month, uint8_t day,
+                          uint8_t hour, uint8_t minute, uint8_t second )
+{
+  struct tm tm;
+  struct timespec times[ 2 ];
+
+  if( ! isOpen())
+    return false;
+  memset( & tm, 0, sizeof( tm ));
+  tm.tm_year = year - 1900;
+  tm.tm_mon = month - 1;
+  tm.tm_mday = day;
+  tm.tm_hour = hour;
+  tm.tm_min = minute;
+  tm.tm_sec = second;
+  tm.tm_isdst = -1;
+  times[ 0 ].tv_nsec = times[ 1 ].tv_nsec = UTIME_OMIT;
+  if( flags & T_ACCESS )
+  {
+    times[ 0 ].tv_sec = mktime( & tm );
+    times[ 0 ].tv_nsec = 0;
+  }
+  if( flags & T_WRITE )
+  {
+    times[ 1 ].tv_sec = mktime( & tm );
+    times[ 1 ].tv_nsec = 0;
+  }
+  return utimensat( AT_FDCWD, hpath.c_str(), times, 0 ) == 0;
+}
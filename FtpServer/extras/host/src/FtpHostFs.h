@@ -0,0 +1,127 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * Files system adapter: classes HostFs and HostFile have the interface
+ *   of SdFat and SdFile (version 2) used by FtpServer.
+ *   All paths are relative to a root directory of the host.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FTP_HOST_FS_H
+#define FTP_HOST_FS_H
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <string>
+
+// Open flags are those of fcntl.h, as in SdFat 2
+#ifndef O_READ
+  #define O_READ  O_RDONLY
+  #define O_WRITE O_WRONLY
+#endif
+
+// Flags for HostFile::timestamp()
+#define T_ACCESS 1
+#define T_CREATE 2
+#define T_WRITE  4
+
+// Cost model of the storage
+// Each access to the files system is reported to the model, which can
+//   advance the virtual clock of the host to simulate the latency of a
+//   memory card (see extras/bench). By default accesses cost nothing.
+
+class HostStorageModel
+{
+public:
+  virtual ~HostStorageModel() {}
+  virtual void lookup( uint16_t names ) {}            // walk of a path of names, open, stat
+  virtual void read( uint64_t pos, size_t nbyte ) {}
+  virtual void write( uint64_t pos, size_t nbyte ) {}
+  virtual void allocate( uint64_t from, uint64_t to ) {} // space given to a file
+};
+
+class HostFs
+{
+public:
+  HostFs() : model( & noCost ), noCase( false ) {}
+  bool begin( const char * _root );
+  void setModel( HostStorageModel * _model ) { model = _model == NULL ? & noCost : _model; };
+  HostStorageModel * getModel() { return model; };
+  bool exists( const char * path );
+  bool remove( const char * path );
+  bool mkdir( const char * path );
+  bool rmdir( const char * path );
+  bool rename( const char * path, const char * newpath );
+  uint32_t capacity();          // in kBytes
+  uint32_t free();              // in kBytes
+
+  // With ignoreCase( true ), names are found without case, as on FAT
+  void ignoreCase( bool ic ) { noCase = ic; };
+  bool caseSensitive() { return ! noCase; };
+
+  std::string hostPath( const char * path ) { return hostPath( root, path ); };
+  std::string hostPath( const std::string & dir, const char * path );
+
+private:
+  std::string root;
+  HostStorageModel * model;
+  HostStorageModel   noCost;
+  bool        noCase;
+};
+
+extern HostFs hostFs;
+
+class HostFile
+{
+public:
+  HostFile() : fd( -1 ), dir( NULL ), allocated( 0 ) {}
+  ~HostFile() { close(); }
+  HostFile( const HostFile & ) = delete;
+  HostFile & operator=( const HostFile & ) = delete;
+
+  bool     open( const char * path, int oflag = O_RDONLY );
+  bool     open( HostFile * dirFile, const char * path, int oflag = O_RDONLY );
+  bool     openNext( HostFile * dirFile, int oflag = O_RDONLY );
+  bool     close();
+  bool     isOpen() { return fd >= 0 || dir != NULL; }
+  bool     isDir() { return dir != NULL; }
+  int      read( void * buf, size_t nbyte );
+  size_t   write( const void * buf, size_t nbyte );
+  int      handle() { return fd; }
+  void     readBy( size_t nbyte );  // nbyte were read from fd by the socket driver
+  uint64_t fileSize();
+  bool     seekSet( uint64_t pos );
+  bool     preAllocate( uint64_t length );
+  bool     truncate();
+  size_t   printName( Print * pr );
+  bool     getModifyDateTime( uint16_t * pdate, uint16_t * ptime );
+  bool     timestamp( uint8_t flags, uint16_t year, uint8_t month, uint8_t day,
+                      uint8_t hour, uint8_t minute, uint8_t second );
+
+private:
+  bool     openHost( const std::string & path, int oflag, uint16_t names );
+
+  int         fd;
+  DIR *       dir;
+  uint64_t    allocated;        // bytes of space given to the file
+  std::string hpath;            // path in the host files system
+  std::string name;             // name of the file, without path
+};
+
+#endif // FTP_HOST_FS_H
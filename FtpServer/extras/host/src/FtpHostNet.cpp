@@ -0,0 +1,307 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * Network adapter
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpHost.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#ifdef __linux__
+  #include <sys/sendfile.h>
+#endif
+
+static BsdSocketDriver bsdDriver;
+HostNet hostNet;
+
+HostNet::HostNet()
+       : driver( & bsdDriver ), ip( 127, 0, 0, 1 ), mask( 255, 0, 0, 0 )
+{
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                          DRIVER FOR BSD SOCKETS                            **
+ **                                                                            **
+ *******************************************************************************/
+
+static void setNonBlocking( int s )
+{
+  fcntl( s, F_SETFL, fcntl( s, F_GETFL ) | O_NONBLOCK );
+}
+
+static void makeAddr( struct sockaddr_in * addr, IPAddress ip, uint16_t port )
+{
+  memset( addr, 0, sizeof( * addr ));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons( port );
+  addr->sin_addr.s_addr = (uint32_t) ip;  // IPAddress is already in network order
+}
+
+int BsdSocketDriver::listen( IPAddress ip, uint16_t port )
+{
+  struct sockaddr_in addr;
+  int on = 1;
+  int s = socket( AF_INET, SOCK_STREAM, 0 );
+
+  if( s < 0 )
+    return -1;
+  setsockopt( s, SOL_SOCKET, SO_REUSEADDR, & on, sizeof( on ));
+  makeAddr( & addr, ip, port );
+  if( bind( s, (struct sockaddr *) & addr, sizeof( addr )) < 0 ||
+      ::listen( s, 4 ) < 0 )
+  {
+    ::close( s );
+    return -1;
+  }
+  setNonBlocking( s );
+  return s;
+}
+
+int BsdSocketDriver::accept( int s )
+{
+  int c = ::accept( s, NULL, NULL );
+  int on = 1;
+
+  if( c < 0 )
+    return -1;
+  setNonBlocking( c );
+  setsockopt( c, IPPROTO_TCP, TCP_NODELAY, & on, sizeof( on ));
+  return c;
+}
+
+int BsdSocketDriver::connect( IPAddress ip, uint16_t port )
+{
+  struct sockaddr_in addr;
+  int s = socket( AF_INET, SOCK_STREAM, 0 );
+
+  if( s < 0 )
+    return -1;
+  makeAddr( & addr, ip, port );
+  if( ::connect( s, (struct sockaddr *) & addr, sizeof( addr )) < 0 )
+  {
+    ::close( s );
+    return -1;
+  }
+  setNonBlocking( s );
+  return s;
+}
+
+int BsdSocketDriver::available( int s )
+{
+  int n = 0;
+
+  if( ioctl( s, FIONREAD, & n ) < 0 )
+    return 0;
+  return n;
+}
+
+int BsdSocketDriver::read( int s, uint8_t * buf, size_t size )
+{
+  ssize_t n = recv( s, buf, size, 0 );
+  return n > 0 ? n : -1;
+}
+
+// Like EthernetClient::write(), wait until all data is given to the stack
+
+size_t BsdSocketDriver::write( int s, const uint8_t * buf, size_t size )
+{
+  size_t sent = 0;
+
+  while( sent < size )
+  {
+    ssize_t n = send( s, buf + sent, size - sent, MSG_NOSIGNAL );
+    if( n > 0 )
+      sent += n;
+    else if( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ))
+    {
+      struct pollfd pfd = { s, POLLOUT, 0 };
+      poll( & pfd, 1, 100 );
+    }
+    else
+      break;
+  }
+  return sent;
+}
+
+int BsdSocketDriver::availableForWrite( int s )
+{
+  int sndbuf = 0, queued = 0;
+  socklen_t len = sizeof( sndbuf );
+
+  if( getsockopt( s, SOL_SOCKET, SO_SNDBUF, & sndbuf, & len ) < 0 ||
+      ioctl( s, TIOCOUTQ, & queued ) < 0 )
+    return 0;
+  return sndbuf > queued ? sndbuf - queued : 0;
+}
+
+bool BsdSocketDriver::connected( int s )
+{
+  uint8_t c;
+  ssize_t n = recv( s, & c, 1, MSG_PEEK | MSG_DONTWAIT );
+  return n > 0 || ( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ));
+}
+
+// sendfile(2) copies the file to the socket inside the kernel. As write(),
+//   it waits while the socket buffer is full
+
+long BsdSocketDriver::sendFile( int s, int fd, size_t size )
+{
+#ifdef __linux__
+  static bool noSigPipe = false;
+  size_t sent = 0;
+
+  if( ! noSigPipe )             // sendfile() has no MSG_NOSIGNAL
+  {
+    signal( SIGPIPE, SIG_IGN );
+    noSigPipe = true;
+  }
+  while( sent < size )
+  {
+    ssize_t n = sendfile( s, fd, NULL, size - sent );
+    if( n > 0 )
+      sent += n;
+    else if( n == 0 )           // end of file
+      break;
+    else if( errno == EAGAIN || errno == EWOULDBLOCK )
+    {
+      struct pollfd pfd = { s, POLLOUT, 0 };
+      poll( & pfd, 1, 100 );
+    }
+    else                        // the caller falls back to read() and write()
+      return sent > 0 ? (long) sent : -1;
+  }
+  return sent;
+#else
+  return -1;
+#endif
+}
+
+void BsdSocketDriver::close( int s )
+{
+  ::close( s );
+}
+
+IPAddress BsdSocketDriver::remoteIP( int s )
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof( addr );
+
+  if( getpeername( s, (struct sockaddr *) & addr, & len ) < 0 )
+    return IPAddress();
+  return IPAddress((uint32_t) addr.sin_addr.s_addr );
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                         CLIENT AND SERVER CLASSES                          **
+ **                                                                            **
+ *******************************************************************************/
+
+int HostClient::connect( IPAddress ip, uint16_t port )
+{
+  stop();
+  s = hostNet.getDriver()->connect( ip, port );
+  return s >= 0;
+}
+
+uint8_t HostClient::connected()
+{
+  return s >= 0 && ( hostNet.getDriver()->available( s ) > 0 ||
+                     hostNet.getDriver()->connected( s ));
+}
+
+int HostClient::available()
+{
+  return s < 0 ? 0 : hostNet.getDriver()->available( s );
+}
+
+int HostClient::availableForWrite()
+{
+  return s < 0 ? 0 : hostNet.getDriver()->availableForWrite( s );
+}
+
+long HostClient::sendFile( HostFile & file, size_t size )
+{
+  if( s < 0 || file.handle() < 0 )
+    return -1;
+  long n = hostNet.getDriver()->sendFile( s, file.handle(), size );
+  if( n > 0 )
+    file.readBy( n );
+  return n;
+}
+
+int HostClient::read()
+{
+  uint8_t c;
+  return read( & c, 1 ) == 1 ? c : -1;
+}
+
+int HostClient::read( uint8_t * buf, size_t size )
+{
+  return s < 0 ? -1 : hostNet.getDriver()->read( s, buf, size );
+}
+
+size_t HostClient::write( const uint8_t * buf, size_t size )
+{
+  return s < 0 ? 0 : hostNet.getDriver()->write( s, buf, size );
+}
+
+void HostClient::stop()
+{
+  if( s >= 0 )
+    hostNet.getDriver()->close( s );
+  s = -1;
+}
+
+// Return a status code like the one of a W5x00 socket
+
+uint8_t HostClient::status()
+{
+  if( s < 0 )
+    return 0x00;               // SnSR::CLOSED
+  return hostNet.getDriver()->connected( s ) ? 0x17   // SnSR::ESTABLISHED
+                                             : 0x1C;  // SnSR::CLOSE_WAIT
+}
+
+IPAddress HostClient::remoteIP()
+{
+  return s < 0 ? IPAddress() : hostNet.getDriver()->remoteIP( s );
+}
+
+void HostServer::begin()
+{
+  if( s < 0 )
+    s = hostNet.getDriver()->listen( hostNet.localIP(), port );
+}
+
+HostClient HostServer::accept()
+{
+  return HostClient( s < 0 ? -1 : hostNet.getDriver()->accept( s ));
+}
@@ -0,0 +1,129 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * Host (Linux) build of the FTP server
+ *
+ * Network adapter: classes HostServer and HostClient have the same interface
+ *   as EthernetServer and EthernetClient. Sockets are managed by a driver.
+ *   The default driver uses BSD sockets.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FTP_HOST_NET_H
+#define FTP_HOST_NET_H
+
+// Interface of a socket driver
+// Sockets are identified by an integer handle, -1 is an invalid handle
+
+class HostSocketDriver
+{
+public:
+  virtual ~HostSocketDriver() {}
+  virtual int       listen( IPAddress ip, uint16_t port ) = 0;
+  virtual int       accept( int s ) = 0;       // return -1 if no client
+  virtual int       connect( IPAddress ip, uint16_t port ) = 0;
+  virtual int       available( int s ) = 0;
+  virtual int       read( int s, uint8_t * buf, size_t size ) = 0; // -1 if nothing to read
+  virtual size_t    write( int s, const uint8_t * buf, size_t size ) = 0;
+  virtual int       availableForWrite( int s ) = 0;
+  virtual bool      connected( int s ) = 0;    // false when closed by peer
+  virtual void      close( int s ) = 0;
+  virtual IPAddress remoteIP( int s ) = 0;
+  // Send size bytes of the file fd from its position, without copy if the
+  //  host can. Return bytes sent (0 at end of file), -1 if not possible
+  virtual long      sendFile( int s, int fd, size_t size ) { return -1; }
+};
+
+// Driver using BSD sockets of the host
+
+class BsdSocketDriver : public HostSocketDriver
+{
+public:
+  int       listen( IPAddress ip, uint16_t port );
+  int       accept( int s );
+  int       connect( IPAddress ip, uint16_t port );
+  int       available( int s );
+  int       read( int s, uint8_t * buf, size_t size );
+  size_t    write( int s, const uint8_t * buf, size_t size );
+  int       availableForWrite( int s );
+  bool      connected( int s );
+  void      close( int s );
+  IPAddress remoteIP( int s );
+  long      sendFile( int s, int fd, size_t size );
+};
+
+// Replace the Ethernet object of the Ethernet library
+
+class HostNet
+{
+public:
+  HostNet();
+  void begin( IPAddress _localIP, IPAddress _subnetMask = IPAddress( 255, 255, 255, 0 ))
+    { ip = _localIP; mask = _subnetMask; };
+  void setDriver( HostSocketDriver * _driver ) { driver = _driver; };
+  HostSocketDriver * getDriver() { return driver; };
+  IPAddress localIP() { return ip; };
+  IPAddress subnetMask() { return mask; };
+
+private:
+  HostSocketDriver * driver;
+  IPAddress ip, mask;
+};
+
+extern HostNet hostNet;
+
+class HostFile;
+
+class HostClient : public Print
+{
+public:
+  HostClient( int _s = -1 ) : s( _s ) {}
+
+  int       connect( IPAddress ip, uint16_t port );
+  uint8_t   connected();
+  int       available();
+  int       availableForWrite();
+  int       read();
+  int       read( uint8_t * buf, size_t size );
+  size_t    write( uint8_t c ) { return write( & c, 1 ); }
+  size_t    write( const uint8_t * buf, size_t size );
+  using     Print::write;
+  long      sendFile( HostFile & file, size_t size );
+  void      stop();
+  uint8_t   status();
+  IPAddress remoteIP();
+  int       handle() { return s; }
+  operator  bool() { return s >= 0; }
+
+private:
+  int s;
+};
+
+class HostServer
+{
+public:
+  HostServer( uint16_t _port ) : port( _port ), s( -1 ) {}
+
+  void       begin();
+  HostClient accept();
+
+private:
+  uint16_t port;
+  int s;
+};
+
+#endif // FTP_HOST_NET_H
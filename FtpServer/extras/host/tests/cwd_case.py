@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+#
+# Host test of the FTP server: a session removes the current directory of
+# an other session, naming it with an other case, as FAT allows.
+#
+# The server runs with -c (names ignore case). Session A goes to /Data,
+# session B removes /DATA and creates /data. A stores a file: the handle
+# of its current directory must have been closed, so the file is stored
+# in the new /data. With a stale handle the store fails (on the host) or
+# writes in freed clusters (on FAT).
+#
+# Usage: cwd_case.py path/to/ftpserver
+
+import ftplib, io, os, shutil, socket, subprocess, sys, tempfile, time
+
+SKIP = 77                       # ctest SKIP_RETURN_CODE
+
+def freePort():
+  s = socket.socket()
+  s.bind(( '127.0.0.1', 0 ))
+  port = s.getsockname()[ 1 ]
+  s.close()
+  return port
+
+def login( port ):
+  f = ftplib.FTP()
+  for i in range( 50 ):         # wait for the server to listen
+    try:
+      f.connect( '127.0.0.1', port, timeout = 5 )
+      break
+    except OSError:
+      time.sleep( 0.1 )
+  f.login( 'arduino', 'test' )
+  return f
+
+def main():
+  root = tempfile.mkdtemp()
+  port = freePort()
+  server = subprocess.Popen([ sys.argv[ 1 ], '-r', root, '-p', str( port ),
+                              '-d', str( freePort()), '-c', '-q' ])
+  try:
+    a = login( port )
+    try:
+      b = login( port )
+    except ftplib.error_temp:
+      print( 'needs FTP_MAX_SESSIONS > 1' )
+      return SKIP
+    a.mkd( '/Data' )
+    a.cwd( '/Data' )
+    b.rmd( '/DATA' )
+    b.mkd( '/data' )
+    a.storbinary( 'STOR x.txt', io.BytesIO( b'hello' ))
+    with open( os.path.join( root, 'data', 'x.txt' ), 'rb' ) as x:
+      if x.read() != b'hello':
+        print( 'x.txt has wrong content' )
+        return 1
+    a.quit()
+    b.quit()
+    return 0
+  except ftplib.Error as e:
+    print( 'FTP error:', e )
+    return 1
+  finally:
+    server.kill()
+    server.wait()
+    shutil.rmtree( root )
+
+sys.exit( main())
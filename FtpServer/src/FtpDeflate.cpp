@@ -0,0 +1,628 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+#ifdef FTP_MODE_Z
+
+#if FTP_MODE_Z_WBITS < 9 || FTP_MODE_Z_WBITS > 14
+  #error FTP_MODE_Z_WBITS must be between 9 and 14
+#endif
+
+// Base values and extra bits of length codes 257..285 and of distance codes
+
+static const uint16_t lenBase[ 29 ] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lenExtra[ 29 ] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distBase[ 30 ] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[ 30 ] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Order of the lengths of code length codes in a dynamic block
+
+static const uint8_t codeLenOrder[ 19 ] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Update the Adler-32 checksum of zlib with nb bytes
+
+static uint32_t adler32( uint32_t adler, const uint8_t * b, uint16_t nb )
+{
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+  while( nb > 0 )
+  {
+    uint16_t n = nb < 5552 ? nb : 5552; // no overflow before modulo
+    nb -= n;
+    while( n -- > 0 )
+    {
+      s1 += * b ++;
+      s2 += s1;
+    }
+    s1 %= 65521;
+    s2 %= 65521;
+  }
+  return ( s2 << 16 ) | s1;
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                               COMPRESSION                                  **
+ **                                                                            **
+ *******************************************************************************/
+
+// Allocate the window and write the zlib header to sink
+//
+//  return false if there is not enough memory
+
+bool FtpDeflate::begin( Print & _sink )
+{
+  end();
+  win = (uint8_t *) malloc( 2 * W + ( sizeof( uint16_t ) << HBITS ) + FTP_MODE_Z_OUT );
+  if( win == NULL )
+    return false;
+  head = (uint16_t *) ( win + 2 * W );
+  out = (uint8_t *) ( head + ( 1 << HBITS ));
+  memset( head, 0xff, sizeof( uint16_t ) << HBITS );
+  sink = & _sink;
+  fill = 0;
+  pos = 0;
+  bitBuf = 0;
+  bitCnt = 0;
+  adler = 1;
+  uint8_t cmf = (( FTP_MODE_Z_WBITS - 8 ) << 4 ) | 8;
+  out[ 0 ] = cmf;
+  out[ 1 ] = ( 31 - ( cmf << 8 ) % 31 ) % 31;
+  nbOut = 2;
+  putBits( 2, 3 );                      // first block, fixed codes
+  return true;
+}
+
+// Compress nb bytes. Output is sent to sink each time FTP_MODE_Z_OUT
+//  bytes are ready. The last bytes wait for more data or for finish()
+
+void FtpDeflate::write( const uint8_t * b, uint16_t nb )
+{
+  adler = adler32( adler, b, nb );
+  while( nb > 0 )
+  {
+    if( fill == 2 * W )
+    {
+      compress( false );
+      slide();
+    }
+    uint16_t n = nb < 2 * W - fill ? nb : 2 * W - fill;
+    memcpy( win + fill, b, n );
+    fill += n;
+    b += n;
+    nb -= n;
+  }
+  compress( false );
+}
+
+// Compress all bytes left, terminate the stream and send it
+
+void FtpDeflate::finish()
+{
+  if( ! active())
+    return;
+  compress( true );
+  putLiteral( 256 );                    // end of block
+  putBits( 3, 3 );                      // last block, fixed codes, empty
+  putLiteral( 256 );
+  if( bitCnt > 0 )
+    putBits( 0, 8 - bitCnt );
+  for( int8_t i = 24; i >= 0; i -= 8 )
+    putBits(( adler >> i ) & 0xff, 8 );
+  sendOut();
+}
+
+void FtpDeflate::end()
+{
+  ::free( win );
+  win = NULL;
+}
+
+// Compress bytes of window from pos. Unless flush is true, the last
+//  bytes are kept so that a match can be as long as possible
+
+void FtpDeflate::compress( bool flush )
+{
+  uint16_t limit = flush ? fill : fill > 258 ? fill - 258 : 0;
+  while( pos < limit )
+  {
+    uint16_t avail = fill - pos;
+    uint16_t len = 0;
+    uint16_t cand = NONE;
+    if( avail >= 3 )
+    {
+      uint16_t h = hash( pos );
+      cand = head[ h ];
+      head[ h ] = pos;
+      if( cand != NONE && pos - cand <= W )
+      {
+        uint16_t max = avail < 258 ? avail : 258;
+        while( len < max && win[ cand + len ] == win[ pos + len ])
+          len ++;
+      }
+    }
+    if( len >= 3 )
+    {
+      putMatch( len, pos - cand );
+      // positions inside the match are entered in hash table too
+      for( uint16_t p = pos + 1; p < pos + len && p + 2 < fill; p ++ )
+        head[ hash( p )] = p;
+      pos += len;
+    }
+    else
+      putLiteral( win[ pos ++ ]);
+  }
+}
+
+// Hash of the 3 bytes at position p of window
+
+uint16_t FtpDeflate::hash( uint16_t p )
+{
+  uint32_t h = (uint32_t) win[ p ] << 16 | win[ p + 1 ] << 8 | win[ p + 2 ];
+  return (uint32_t) ( h * 2654435761UL ) >> ( 32 - HBITS );
+}
+
+// Move the last W bytes of window to its beginning
+
+void FtpDeflate::slide()
+{
+  memmove( win, win + W, W );
+  fill -= W;
+  pos -= W;
+  for( uint16_t i = 0; i < ( 1 << HBITS ); i ++ )
+    head[ i ] = head[ i ] != NONE && head[ i ] >= W ? head[ i ] - W : NONE;
+}
+
+// Add n bits of value to output, from the least significant one
+
+void FtpDeflate::putBits( uint32_t value, uint8_t n )
+{
+  bitBuf |= value << bitCnt;
+  bitCnt += n;
+  while( bitCnt >= 8 )
+  {
+    out[ nbOut ++ ] = bitBuf;
+    bitBuf >>= 8;
+    bitCnt -= 8;
+    if( nbOut == FTP_MODE_Z_OUT )
+      sendOut();
+  }
+}
+
+// Huffman codes are written from the most significant bit
+
+void FtpDeflate::putCode( uint16_t code, uint8_t n )
+{
+  uint16_t rev = 0;
+  for( uint8_t i = 0; i < n; i ++ )
+  {
+    rev = ( rev << 1 ) | ( code & 1 );
+    code >>= 1;
+  }
+  putBits( rev, n );
+}
+
+// Fixed code of literal or length symbol c
+
+void FtpDeflate::putLiteral( uint16_t c )
+{
+  if( c < 144 )
+    putCode( 0x30 + c, 8 );
+  else if( c < 256 )
+    putCode( 0x190 + c - 144, 9 );
+  else if( c < 280 )
+    putCode( c - 256, 7 );
+  else
+    putCode( 0xc0 + c - 280, 8 );
+}
+
+void FtpDeflate::putMatch( uint16_t len, uint16_t dist )
+{
+  uint8_t i = 28;
+  while( lenBase[ i ] > len )
+    i --;
+  putLiteral( 257 + i );
+  putBits( len - lenBase[ i ], lenExtra[ i ]);
+  i = 29;
+  while( distBase[ i ] > dist )
+    i --;
+  putCode( i, 5 );
+  putBits( dist - distBase[ i ], distExtra[ i ]);
+}
+
+void FtpDeflate::sendOut()
+{
+  if( nbOut > 0 )
+    sink->write( out, nbOut );
+  nbOut = 0;
+}
+
+/*******************************************************************************
+ **                                                                            **
+ **                              DECOMPRESSION                                 **
+ **                                                                            **
+ *******************************************************************************/
+
+// Allocate the state. The window is allocated when the header is read
+//
+//  return false if there is not enough memory
+
+bool FtpInflate::begin()
+{
+  end();
+  s = (State *) malloc( sizeof( State ));
+  err = s == NULL ? ErrMemory : Ok;
+  if( s == NULL )
+    return false;
+  s->state = Header;
+  s->iIn = 0;
+  s->nbIn = 0;
+  bitBuf = 0;
+  bitCnt = 0;
+  adler = 1;
+  return true;
+}
+
+// Return where to add compressed input, and in room the number of
+//  bytes that can be added. Then added() must be called
+
+uint8_t * FtpInflate::input( uint16_t * room )
+{
+  if( s->iIn > 0 )
+  {
+    s->nbIn -= s->iIn;
+    memmove( s->in, s->in + s->iIn, s->nbIn );
+    s->iIn = 0;
+  }
+  * room = FTP_MODE_Z_IN - s->nbIn;
+  return s->in + s->nbIn;
+}
+
+// Decompress input to b, up to size bytes
+//
+//  return the number of bytes, 0 if more input is needed or the stream
+//    is terminated (see done()), -1 if the stream is not valid (see error())
+
+int16_t FtpInflate::read( uint8_t * b, uint16_t size )
+{
+  uint16_t n = 0,                       // bytes in b
+           nAdler = 0;                  // bytes of b in checksum
+  bool     wait = false;                // more input is needed
+  int16_t  sym;
+  uint8_t  len, e;
+
+  if( err != Ok )
+    return -1;
+  while( ! wait && s->state != Done )
+    switch( s->state )
+    {
+      case Header:
+        if( ! ( wait = ! need( 16 )))
+        {
+          uint8_t cmf = getBits( 8 );
+          uint8_t flg = getBits( 8 );
+          if(( cmf & 0x0f ) != 8 || ( cmf >> 4 ) > 7 || ( flg & 0x20 ) ||
+             (( cmf << 8 ) | flg ) % 31 != 0 )
+            return fail( ErrData );
+          wmask = ( 1 << (( cmf >> 4 ) + 8 )) - 1;
+          win = (uint8_t *) malloc( wmask + 1 );
+          if( win == NULL )
+            return fail( ErrMemory );
+          wpos = 0;
+          wfull = false;
+          s->state = Block;
+        }
+        break;
+      case Block:
+        if( ! ( wait = ! need( 3 )))
+        {
+          s->final = getBits( 1 );
+          uint8_t type = getBits( 2 );
+          if( type == 0 )
+          {
+            getBits( bitCnt % 8 );
+            s->state = StoredLen;
+          }
+          else if( type == 1 )
+          {
+            memset( s->lens, 8, 144 );
+            memset( s->lens + 144, 9, 112 );
+            memset( s->lens + 256, 7, 24 );
+            memset( s->lens + 280, 8, 8 );
+            build( & s->lit, s->lens, 288 );
+            memset( s->lens, 5, 30 );
+            build( & s->dist, s->lens, 30 );
+            s->state = Symbol;
+          }
+          else if( type == 2 )
+            s->state = Table;
+          else
+            return fail( ErrData );
+        }
+        break;
+      case StoredLen:
+        if( ! ( wait = ! need( 32 )))
+        {
+          s->stored = getBits( 16 );
+          if( s->stored != (uint16_t) ~ getBits( 16 ))
+            return fail( ErrData );
+          s->state = s->stored > 0 ? Stored : s->final ? Check : Block;
+        }
+        break;
+      case Stored:
+        while( s->stored > 0 && n < size && ! ( wait = ! need( 8 )))
+        {
+          put( b, n, getBits( 8 ));
+          s->stored --;
+        }
+        if( s->stored == 0 )
+          s->state = s->final ? Check : Block;
+        wait = wait || n == size;
+        break;
+      case Table:
+        if( ! ( wait = ! need( 14 )))
+        {
+          s->nLit = getBits( 5 ) + 257;
+          s->nDist = getBits( 5 ) + 1;
+          s->nLen = getBits( 4 ) + 4;
+          if( s->nLit > 286 || s->nDist > 30 )
+            return fail( ErrData );
+          memset( s->lens, 0, 19 );
+          s->iLen = 0;
+          s->state = CodeLenLens;
+        }
+        break;
+      case CodeLenLens:
+        while( s->iLen < s->nLen && ! ( wait = ! need( 3 )))
+          s->lens[ codeLenOrder[ s->iLen ++ ]] = getBits( 3 );
+        if( s->iLen == s->nLen )
+        {
+          build( & s->dist, s->lens, 19 );
+          s->iLen = 0;
+          s->state = CodeLens;
+        }
+        break;
+      case CodeLens:
+        while( s->iLen < s->nLit + s->nDist )
+        {
+          fillBits();
+          if(( sym = peek( & s->dist, & len )) == -1 )
+          {
+            wait = true;
+            break;
+          }
+          if( sym < 0 || sym > 18 )
+            return fail( ErrData );
+          if( sym < 16 )
+          {
+            getBits( len );
+            s->lens[ s->iLen ++ ] = sym;
+            continue;
+          }
+          e = sym == 16 ? 2 : sym == 17 ? 3 : 7;
+          if(( wait = ! need( len + e )))
+            break;
+          getBits( len );
+          uint16_t rep = getBits( e ) + ( sym == 18 ? 11 : 3 );
+          if(( sym == 16 && s->iLen == 0 ) || s->iLen + rep > s->nLit + s->nDist )
+            return fail( ErrData );
+          uint8_t val = sym == 16 ? s->lens[ s->iLen - 1 ] : 0;
+          memset( s->lens + s->iLen, val, rep );
+          s->iLen += rep;
+        }
+        if( s->iLen == s->nLit + s->nDist )
+        {
+          if( s->lens[ 256 ] == 0 )
+            return fail( ErrData );
+          build( & s->lit, s->lens, s->nLit );
+          build( & s->dist, s->lens + s->nLit, s->nDist );
+          s->state = Symbol;
+        }
+        break;
+      case Symbol:
+        while( n < size )
+        {
+          fillBits();
+          if(( sym = peek( & s->lit, & len )) == -1 )
+          {
+            wait = true;
+            break;
+          }
+          if( sym < 0 || sym > 285 )
+            return fail( ErrData );
+          if( sym < 256 )
+          {
+            getBits( len );
+            put( b, n, sym );
+            continue;
+          }
+          if( sym == 256 )
+          {
+            getBits( len );
+            s->state = s->final ? Check : Block;
+            break;
+          }
+          e = lenExtra[ sym - 257 ];
+          if(( wait = ! need( len + e )))
+            break;
+          getBits( len );
+          s->copyLen = lenBase[ sym - 257 ] + getBits( e );
+          s->state = Distance;
+          break;
+        }
+        wait = wait || n == size;
+        break;
+      case Distance:
+        fillBits();
+        if(( sym = peek( & s->dist, & len )) == -1 )
+          wait = true;
+        else if( sym < 0 || sym > 29 )
+          return fail( ErrData );
+        else if( ! ( wait = ! need( len + distExtra[ sym ])))
+        {
+          getBits( len );
+          s->copyDist = distBase[ sym ] + getBits( distExtra[ sym ]);
+          if( s->copyDist > wmask + 1 || ( ! wfull && s->copyDist > wpos ))
+            return fail( ErrData );
+          s->state = Copy;
+        }
+        break;
+      case Copy:
+        while( s->copyLen > 0 && n < size )
+        {
+          put( b, n, win[ ( wpos - s->copyDist ) & wmask ]);
+          s->copyLen --;
+        }
+        if( s->copyLen == 0 )
+          s->state = Symbol;
+        wait = n == size;
+        break;
+      case Check:
+        getBits( bitCnt % 8 );
+        if( ! ( wait = ! need( 32 )))
+        {
+          adler = adler32( adler, b + nAdler, n - nAdler );
+          nAdler = n;
+          uint32_t check = 0;
+          for( uint8_t i = 0; i < 4; i ++ )
+            check = ( check << 8 ) | getBits( 8 );
+          if( check != adler )
+            return fail( ErrData );
+          s->state = Done;
+        }
+        break;
+    }
+  adler = adler32( adler, b + nAdler, n - nAdler );
+  return n;
+}
+
+void FtpInflate::end()
+{
+  ::free( win );
+  ::free( s );
+  win = NULL;
+  s = NULL;
+}
+
+// Output byte c to b, and keep it in window
+
+void FtpInflate::put( uint8_t * b, uint16_t & n, uint8_t c )
+{
+  b[ n ++ ] = c;
+  win[ wpos ] = c;
+  wpos = ( wpos + 1 ) & wmask;
+  if( wpos == 0 )
+    wfull = true;
+}
+
+// Move bytes of input to bit buffer
+
+void FtpInflate::fillBits()
+{
+  while( bitCnt <= 24 && s->iIn < s->nbIn )
+  {
+    bitBuf |= (uint32_t) s->in[ s->iIn ++ ] << bitCnt;
+    bitCnt += 8;
+  }
+}
+
+// Return true if n bits are available
+
+bool FtpInflate::need( uint8_t n )
+{
+  fillBits();
+  return bitCnt >= n;
+}
+
+// Remove n bits (16 at most) from bit buffer and return them
+
+uint32_t FtpInflate::getBits( uint8_t n )
+{
+  uint32_t v = bitBuf & (( 1UL << n ) - 1 );
+  bitBuf >>= n;
+  bitCnt -= n;
+  return v;
+}
+
+// Decode next symbol of bit buffer with tree t, without removing its bits
+//
+//  return the symbol and its length in len, -1 if more bits are needed,
+//    -2 if the code is not valid
+
+int16_t FtpInflate::peek( Tree * t, uint8_t * len )
+{
+  int16_t sum = 0, cur = 0;
+  for( uint8_t l = 1; l < 16; l ++ )
+  {
+    if( l > bitCnt )
+      return -1;
+    cur = 2 * cur + (( bitBuf >> ( l - 1 )) & 1 );
+    sum += t->counts[ l ];
+    cur -= t->counts[ l ];
+    if( cur < 0 )
+    {
+      * len = l;
+      return t->symbols[ sum + cur ];
+    }
+  }
+  return -2;
+}
+
+// Build canonical Huffman tree t from code lengths of num symbols
+
+void FtpInflate::build( Tree * t, const uint8_t * lengths, uint16_t num )
+{
+  uint16_t offs[ 16 ];
+
+  memset( t->counts, 0, sizeof( t->counts ));
+  for( uint16_t i = 0; i < num; i ++ )
+    t->counts[ lengths[ i ]] ++;
+  t->counts[ 0 ] = 0;
+  for( uint16_t i = 0, sum = 0; i < 16; i ++ )
+  {
+    offs[ i ] = sum;
+    sum += t->counts[ i ];
+  }
+  for( uint16_t i = 0; i < num; i ++ )
+    if( lengths[ i ] != 0 )
+      t->symbols[ offs[ lengths[ i ]] ++ ] = i;
+}
+
+// Stream is not valid, or there is not enough memory
+//
+//  return -1, as read()
+
+int16_t FtpInflate::fail( uint8_t e )
+{
+  err = e;
+  return -1;
+}
+
+#endif // FTP_MODE_Z
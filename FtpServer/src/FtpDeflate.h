@@ -0,0 +1,147 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                   COMPRESSION OF TRANSFERS (MODE Z)                        **
+ **                                                                            **
+ *******************************************************************************/
+
+// In MODE Z, data is sent as a zlib stream (RFC 1950, 1951).
+// FtpDeflate compresses downloads and listings with fixed Huffman codes and
+//  a window of 1 << FTP_MODE_Z_WBITS bytes. Each sequence of 3 bytes is
+//  searched once in a hash table, without chains, so the cost per byte is
+//  low and constant.
+// FtpInflate decompresses uploads. It accepts any stream, so its window is
+//  the one declared by the client (up to 32 kbytes).
+// Memory is allocated by begin() and released by end(), only while a
+//  compressed transfer is in progress.
+
+#ifndef FTP_DEFLATE_H
+#define FTP_DEFLATE_H
+
+#ifdef FTP_MODE_Z
+
+#define FTP_MODE_Z_OUT 512            // size of buffer of compressed output
+#define FTP_MODE_Z_IN  512            // size of buffer of compressed input
+
+class FtpDeflate
+{
+public:
+  FtpDeflate() : win( NULL ) {};
+
+  bool   begin( Print & _sink );
+  void   write( const uint8_t * b, uint16_t nb );
+  void   finish();
+  void   end();
+  bool   active() { return win != NULL; };
+
+private:
+  enum { W = 1 << FTP_MODE_Z_WBITS,   // size of the window
+         HBITS = FTP_MODE_Z_WBITS - 1,// bits of hash of 3 bytes
+         NONE = 0xffff };             // no position in head[]
+
+  void     compress( bool flush );
+  uint16_t hash( uint16_t p );
+  void     slide();
+  void     putBits( uint32_t value, uint8_t n );
+  void     putCode( uint16_t code, uint8_t n );
+  void     putLiteral( uint16_t c );
+  void     putMatch( uint16_t len, uint16_t dist );
+  void     sendOut();
+
+  Print *   sink;                     // where compressed data goes
+  uint8_t * win;                      // the last W bytes, then bytes to compress
+  uint16_t * head;                    // last position of each hash
+  uint8_t * out;                      // compressed bytes not yet sent
+  uint16_t  fill,                     // bytes in win
+            pos,                      // next byte of win to compress
+            nbOut;                    // bytes in out
+  uint32_t  bitBuf,                   // bits not yet in out
+            adler;                    // checksum of uncompressed data
+  uint8_t   bitCnt;
+};
+
+class FtpInflate
+{
+public:
+  FtpInflate() : s( NULL ), win( NULL ), err( Ok ) {};
+
+  enum { Ok = 0, ErrData, ErrMemory };
+
+  bool      begin();
+  uint8_t * input( uint16_t * room );
+  void      added( uint16_t nb ) { s->nbIn += nb; };
+  int16_t   read( uint8_t * b, uint16_t size );
+  bool      pending() { return s != NULL && s->iIn < s->nbIn; };
+  bool      done() { return s != NULL && s->state == Done; };
+  uint8_t   error() { return err; };
+  void      end();
+  bool      active() { return s != NULL; };
+
+private:
+  enum { Header = 0, Block, StoredLen, Stored, Table, CodeLenLens, CodeLens,
+         Symbol, Distance, Copy, Check, Done };
+
+  struct Tree
+  {
+    uint16_t counts[ 16 ];            // number of codes of each length
+    uint16_t symbols[ 288 ];          // symbols ordered by code
+  };
+
+  struct State
+  {
+    Tree     lit,                     // literal/length codes
+             dist;                    // distance codes, or code length codes
+    uint8_t  lens[ 288 + 32 ];        // lengths of codes of a dynamic block
+    uint8_t  in[ FTP_MODE_Z_IN ];     // compressed input
+    uint16_t iIn,                     // next byte of in to decode
+             nbIn;                    // bytes in in
+    uint8_t  state;
+    bool     final;                   // block is the last one
+    uint16_t nLit, nDist, nLen,       // sizes of tables of a dynamic block
+             iLen,                    // next length to read
+             stored,                  // bytes left in stored block
+             copyLen,                 // bytes left to copy from the window
+             copyDist;
+  };
+
+  void      fillBits();
+  bool      need( uint8_t n );
+  uint32_t  getBits( uint8_t n );
+  int16_t   peek( Tree * t, uint8_t * len );
+  void      build( Tree * t, const uint8_t * lengths, uint16_t num );
+  void      put( uint8_t * b, uint16_t & n, uint8_t c );
+  int16_t   fail( uint8_t e );
+
+  State *   s;
+  uint8_t * win;                      // the last bytes decompressed
+  uint16_t  wmask,                    // size of win - 1
+            wpos;                     // next position in win
+  bool      wfull;                    // win was filled at least once
+  uint32_t  bitBuf,
+            adler;
+  uint8_t   bitCnt,
+            err;
+};
+
+#endif // FTP_MODE_Z
+
+#endif // FTP_DEFLATE_H
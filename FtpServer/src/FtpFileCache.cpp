@@ -0,0 +1,195 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+#if FTP_FILE_CACHE_SIZE > 0
+
+FtpFileCache::FtpFileCache()
+{
+  memset( slots, 0, sizeof( slots ));
+  used = 0;
+  useCount = 0;
+}
+
+// Return the slot where content of path is ready, or -1
+//  The slot must be released when the file is closed
+
+int8_t FtpFileCache::find( const char * path )
+{
+  uint32_t hash = hashOf( path );
+  for( int8_t i = 0; i < FTP_FILE_CACHE_SLOTS; i ++ )
+  {
+    Slot & s = slots[ i ];
+    if( s.state == Ready && s.hash == hash && ftpSamePath( s.path, path, strlen( path ) + 1 ))
+    {
+      s.users ++;
+      s.lastUse = ++ useCount;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void FtpFileCache::release( int8_t slot )
+{
+  Slot & s = slots[ slot ];
+  if( s.users > 0 )
+    s.users --;
+  if( s.state == Stale && s.users == 0 )
+    freeSlot( slot );
+}
+
+// Reserve a slot and size bytes to store the content of path
+//  Other files are removed if needed. The slot is used by the caller
+//
+//  return -1 if there is no room
+
+int8_t FtpFileCache::fill( const char * path, uint32_t size )
+{
+  if( size > FTP_FILE_CACHE_SIZE )
+    return -1;
+  while( used + size > FTP_FILE_CACHE_SIZE )
+    if( ! evict())
+      return -1;
+  int8_t slot = -1;
+  for( int8_t i = 0; i < FTP_FILE_CACHE_SLOTS; i ++ )
+    if( slots[ i ].state == Free )
+    {
+      slot = i;
+      break;
+    }
+  if( slot < 0 && evict())
+    return fill( path, size );
+  if( slot < 0 )
+    return -1;
+  Slot & s = slots[ slot ];
+  s.pdata = (uint8_t *) FTP_FILE_CACHE_MALLOC( size );
+  if( s.pdata == NULL )
+    return -1;
+  s.path = strdup( path );
+  if( s.path == NULL )
+  {
+    ::free( s.pdata );
+    s.pdata = NULL;
+    return -1;
+  }
+  used += size;
+  s.hash = hashOf( path );
+  s.size = size;
+  s.users = 1;
+  s.state = Filling;
+  return slot;
+}
+
+// Content of file is in buffer( slot ). It is kept only if the file
+//  was not changed while it was read
+
+void FtpFileCache::commit( int8_t slot )
+{
+  Slot & s = slots[ slot ];
+  if( s.state != Filling )
+    return;
+  s.lastUse = ++ useCount;
+  s.state = Ready;
+}
+
+void FtpFileCache::cancel( int8_t slot )
+{
+  freeSlot( slot );
+}
+
+// A file or directory was changed: remove path and the files inside it
+
+void FtpFileCache::invalidate( const char * path )
+{
+  size_t lpath = strlen( path );
+  for( int8_t i = 0; i < FTP_FILE_CACHE_SLOTS; i ++ )
+  {
+    Slot & s = slots[ i ];
+    if( s.state == Free || s.state == Stale )
+      continue;
+    if( strlen( s.path ) >= lpath && ftpSamePath( s.path, path, lpath ) &&
+        ( s.path[ lpath ] == 0 || s.path[ lpath ] == '/' || lpath == 1 ))
+      remove( i );
+  }
+}
+
+// Remove file with hash given by hashOf()
+
+void FtpFileCache::invalidateHash( uint32_t hash )
+{
+  for( int8_t i = 0; i < FTP_FILE_CACHE_SLOTS; i ++ )
+    if(( slots[ i ].state == Filling || slots[ i ].state == Ready ) &&
+        slots[ i ].hash == hash )
+      remove( i );
+}
+
+// FNV-1a hash of path, ignoring case if the files system does
+
+uint32_t FtpFileCache::hashOf( const char * path )
+{
+  bool cs = FtpFs::caseSensitive();
+  uint32_t h = 2166136261UL;
+  while( * path != 0 )
+  {
+    uint8_t c = * path ++;
+    h = ( h ^ ( cs ? c : tolower( c ))) * 16777619UL;
+  }
+  return h;
+}
+
+// Content is freed now, or when the last session reading it releases it
+
+void FtpFileCache::remove( int8_t slot )
+{
+  if( slots[ slot ].users > 0 )
+    slots[ slot ].state = Stale;
+  else
+    freeSlot( slot );
+}
+
+void FtpFileCache::freeSlot( int8_t slot )
+{
+  Slot & s = slots[ slot ];
+  ::free( s.path );
+  ::free( s.pdata );
+  used -= s.size;
+  memset( & s, 0, sizeof( s ));
+}
+
+// Remove the least recently used file that is not being read
+//
+//  return false if no file can be removed
+
+bool FtpFileCache::evict()
+{
+  int8_t lru = -1;
+  for( int8_t i = 0; i < FTP_FILE_CACHE_SLOTS; i ++ )
+    if( slots[ i ].state == Ready && slots[ i ].users == 0 &&
+        ( lru < 0 || slots[ i ].lastUse < slots[ lru ].lastUse ))
+      lru = i;
+  if( lru < 0 )
+    return false;
+  freeSlot( lru );
+  return true;
+}
+
+#endif // FTP_FILE_CACHE_SIZE > 0
@@ -0,0 +1,85 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                        CACHE OF SMALL FILES                                **
+ **                                                                            **
+ *******************************************************************************/
+
+// Files of at most FTP_FILE_CACHE_MAX bytes are read whole into the cache
+//  the first time they are opened by RETR or HASH, and are then read from
+//  it without opening them.
+// Any change of a file (STOR, APPE, DELE, RNFR, RMD) removes it from the
+//  cache, with the files of a directory that is changed.
+// When there is no room for a new file, the least recently used files that
+//  are not being read are removed. A file that is removed while read is
+//  freed when released.
+
+#ifndef FTP_FILE_CACHE_H
+#define FTP_FILE_CACHE_H
+
+#if FTP_FILE_CACHE_SIZE > 0
+
+class FtpFileCache
+{
+public:
+  FtpFileCache();
+
+  int8_t   find( const char * path );
+  void     release( int8_t slot );
+  const uint8_t * data( int8_t slot ) { return slots[ slot ].pdata; };
+  uint32_t size( int8_t slot ) { return slots[ slot ].size; };
+
+  int8_t   fill( const char * path, uint32_t size );
+  uint8_t * buffer( int8_t slot ) { return slots[ slot ].pdata; };
+  void     commit( int8_t slot );
+  void     cancel( int8_t slot );
+
+  void     invalidate( const char * path );
+  void     invalidateHash( uint32_t hash );
+  uint32_t hashOf( const char * path );
+
+private:
+  enum { Free = 0, Filling, Ready, Stale };
+
+  struct Slot
+  {
+    char *   path;                    // file cached
+    uint32_t hash;                    // hash of path
+    uint8_t * pdata;                  // content of file
+    uint32_t size,                    // bytes in pdata
+             lastUse;
+    uint8_t  state,
+             users;                   // number of sessions reading this file
+  };
+
+  void     remove( int8_t slot );
+  void     freeSlot( int8_t slot );
+  bool     evict();
+
+  Slot     slots[ FTP_FILE_CACHE_SLOTS ];
+  uint32_t used,                      // bytes allocated for all slots
+           useCount;
+};
+
+#endif // FTP_FILE_CACHE_SIZE > 0
+
+#endif // FTP_FILE_CACHE_H
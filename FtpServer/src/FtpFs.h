@@ -0,0 +1,242 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                       OPERATIONS OF FILE SYSTEMS                           **
+ **                                                                            **
+ *******************************************************************************/
+
+// Everything that differs between the libraries of file systems is here.
+// FtpFs is the class of the library selected by FTP_FILESYST. Its methods
+//  are static and inline, so the sessions call the library directly.
+// A new file system is added with its own class having the same methods.
+// FtpFs is a typedef, not a template parameter of FtpServer: FTP_FILESYST
+//  links one library only, and a template would move FtpServer.cpp into
+//  the headers, compiled again by each file that includes them.
+
+#ifndef FTP_FS_H
+#define FTP_FS_H
+
+#if FTP_FILESYST <= FTP_SDFAT2
+  #include <SdFat.h>
+  #define FTP_FS sd
+  #define FTP_FILE SdFile
+  #define FTP_DIR SdFile
+  extern SdFat FTP_FS;
+#elif FTP_FILESYST == FTP_SPIFM
+  #include <SdFat.h>
+  #include <Adafruit_SPIFlash.h>
+  #define FTP_FS fatfs
+  #define FTP_FILE File
+  #define FTP_DIR File
+  extern FatFileSystem FTP_FS;
+  extern Adafruit_SPIFlash flash;
+#elif FTP_FILESYST == FTP_FATFS
+  #include <FatFs.h>
+  #define FTP_FS sdff
+  #define FTP_FILE FileFs
+  #define FTP_DIR DirFs
+  extern FatFsClass FTP_FS;
+  #define O_READ     FA_READ
+  #define O_WRITE    FA_WRITE
+  #define O_RDWR     FA_READ | FA_WRITE
+  #define O_CREAT    FA_CREATE_ALWAYS
+  #define O_APPEND   FA_OPEN_APPEND
+#elif FTP_FILESYST == FTP_POSIX
+  #define FTP_FS hostFs
+  #define FTP_FILE HostFile
+  #define FTP_DIR HostFile
+#endif
+
+// Files systems that can give contiguous space to a file before it is written
+#if FTP_FILESYST == FTP_SDFAT2 || FTP_FILESYST == FTP_POSIX
+  #define FTP_PREALLOCATE
+#endif
+
+// FatFs can not open a file relative to a directory
+#if FTP_FILESYST == FTP_FATFS
+  #undef FTP_CWD_HANDLE
+#endif
+
+#if FTP_FILESYST == FTP_FATFS
+
+// Library FatFs. Entries of a directory are read from the directory itself
+
+class FtpFsFatFs
+{
+public:
+  static bool     exists( const char * path ) { return FTP_FS.exists( path ); };
+  static bool     remove( const char * path ) { return FTP_FS.remove( path ); };
+  static bool     makeDir( const char * path ) { return FTP_FS.mkdir( path ); };
+  static bool     removeDir( const char * path ) { return FTP_FS.rmdir( path ); };
+  static bool     rename( const char * path, const char * newpath )
+                    { return FTP_FS.rename( path, newpath ); };
+  static uint32_t capacity() { return FTP_FS.capacity(); };
+  static uint32_t free() { return FTP_FS.free(); };
+  static bool     legalChar( char c ) { return 0x1f < c && c < 0xff; };
+  static bool     caseSensitive() { return false; };
+  static bool     writeMode( int oflag ) { return ( oflag & FA_WRITE ) != 0; };
+
+  // Fill the attributes of path. f is open on path if opened is true,
+  //  but FatFs can not open a directory
+  static bool     stat( FTP_FILE & f, bool opened, const char * path, bool * pisDir,
+                        uint64_t * psize, uint16_t * pdate, uint16_t * ptime )
+  {
+    bool ex = opened || FTP_FS.exists( path );
+    if( ex )
+    {
+      * pisDir = ! opened && FTP_FS.isDir( (char *) path );
+      FTP_FS.getFileModTime( (char *) path, pdate, ptime );
+      if( opened )
+        * psize = f.fileSize();
+    }
+    if( opened )
+      f.close();
+    return ex;
+  };
+  static bool     timeStamp( FTP_FILE & f, bool opened, char * path,
+                             uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hour, uint8_t minute, uint8_t second )
+  {
+    if( opened )
+      f.close();
+    return FTP_FS.timeStamp( path, year, month, day, hour, minute, second );
+  };
+  static bool     stampByPath() { return true; };
+
+  static bool     nextEntry( FTP_DIR & dir, FTP_FILE & f ) { return dir.nextFile(); };
+  static bool     entryIsDir( FTP_DIR & dir, FTP_FILE & f ) { return dir.isDir(); };
+  static uint64_t entrySize( FTP_DIR & dir, FTP_FILE & f ) { return dir.fileSize(); };
+  static bool     entryModTime( FTP_DIR & dir, FTP_FILE & f, uint16_t * pdate, uint16_t * ptime )
+  {
+    * pdate = dir.fileModDate();
+    * ptime = dir.fileModTime();
+    return true;
+  };
+  static void     printEntryName( FTP_DIR & dir, FTP_FILE & f, Print * p ) { p->print( dir.fileName()); };
+  static void     endEntry( FTP_DIR & dir, FTP_FILE & f ) {};
+
+  static bool     preAllocate( FTP_FILE & f, uint32_t size ) { return false; };
+  static bool     truncate( FTP_FILE & f ) { return true; };  // O_CREAT truncates at open
+};
+
+typedef FtpFsFatFs FtpFs;
+
+#else
+
+// SdFat and the libraries sharing its interface (Adafruit fork, host).
+//  Each entry of a directory is opened in f
+
+class FtpFsSdFat
+{
+public:
+  static bool     exists( const char * path ) { return FTP_FS.exists( path ); };
+  static bool     remove( const char * path ) { return FTP_FS.remove( path ); };
+  static bool     makeDir( const char * path ) { return FTP_FS.mkdir( path ); };
+  static bool     removeDir( const char * path ) { return FTP_FS.rmdir( path ); };
+  static bool     rename( const char * path, const char * newpath )
+                    { return FTP_FS.rename( path, newpath ); };
+#if FTP_FILESYST == FTP_SDFAT1
+  static uint32_t capacity() { return FTP_FS.card()->cardSize() >> 1; };
+  static uint32_t free() { return FTP_FS.vol()->freeClusterCount() *
+                                  FTP_FS.vol()->sectorsPerCluster() >> 1; };
+#elif FTP_FILESYST == FTP_SDFAT2
+  static uint32_t capacity() { return FTP_FS.card()->sectorCount() >> 1; };
+  static uint32_t free() { return FTP_FS.vol()->freeClusterCount() *
+                                  FTP_FS.vol()->sectorsPerCluster() >> 1; };
+#elif FTP_FILESYST == FTP_SPIFM
+  static uint32_t capacity() { return flash.size() >> 10; };
+  static uint32_t free() { return 0; };    // TODO //
+#else
+  static uint32_t capacity() { return FTP_FS.capacity(); };
+  static uint32_t free() { return FTP_FS.free(); };
+#endif
+  static bool     legalChar( char c ) { return 0x1f < c && c < 0x7f; };
+#if FTP_FILESYST == FTP_POSIX
+  static bool     caseSensitive() { return FTP_FS.caseSensitive(); };
+#else
+  static bool     caseSensitive() { return false; };   // Fat and exFat
+#endif
+  // With the flags of fcntl.h (SdFat 2, POSIX) O_RDWR does not hold O_WRITE
+  static bool     writeMode( int oflag ) { return ( oflag & O_ACCMODE ) != O_RDONLY; };
+
+  // Date and time of last modification of file f, that is open
+  static bool     modTime( FTP_FILE & f, uint16_t * pdate, uint16_t * ptime )
+  {
+  #if FTP_FILESYST == FTP_SDFAT1 || FTP_FILESYST == FTP_SPIFM
+    dir_t d;
+
+    if( ! f.dirEntry( & d ))
+      return false;
+    * pdate = d.lastWriteDate;
+    * ptime = d.lastWriteTime;
+    return true;
+  #else
+    return f.getModifyDateTime( pdate, ptime );
+  #endif
+  };
+
+  // Fill the attributes of path. f is open on path if opened is true
+  static bool     stat( FTP_FILE & f, bool opened, const char * path, bool * pisDir,
+                        uint64_t * psize, uint16_t * pdate, uint16_t * ptime )
+  {
+    if( ! opened )
+      return false;
+    * pisDir = f.isDir();
+    * psize = f.fileSize();
+    modTime( f, pdate, ptime );
+    f.close();
+    return true;
+  };
+  static bool     timeStamp( FTP_FILE & f, bool opened, char * path,
+                             uint16_t year, uint8_t month, uint8_t day,
+                             uint8_t hour, uint8_t minute, uint8_t second )
+  {
+    if( ! opened )
+      return false;
+    bool res = f.timestamp( T_WRITE, year, month, day, hour, minute, second );
+    f.close();
+    return res;
+  };
+  static bool     stampByPath() { return false; };
+
+  static bool     nextEntry( FTP_DIR & dir, FTP_FILE & f ) { return f.openNext( & dir, O_RDONLY ); };
+  static bool     entryIsDir( FTP_DIR & dir, FTP_FILE & f ) { return f.isDir(); };
+  static uint64_t entrySize( FTP_DIR & dir, FTP_FILE & f ) { return f.fileSize(); };
+  static bool     entryModTime( FTP_DIR & dir, FTP_FILE & f, uint16_t * pdate, uint16_t * ptime )
+                    { return modTime( f, pdate, ptime ); };
+  static void     printEntryName( FTP_DIR & dir, FTP_FILE & f, Print * p ) { f.printName( p ); };
+  static void     endEntry( FTP_DIR & dir, FTP_FILE & f ) { f.close(); };
+
+#ifdef FTP_PREALLOCATE
+  static bool     preAllocate( FTP_FILE & f, uint32_t size ) { return f.preAllocate( size ); };
+  static bool     truncate( FTP_FILE & f ) { return f.truncate(); };
+#else
+  static bool     preAllocate( FTP_FILE & f, uint32_t size ) { return false; };
+  static bool     truncate( FTP_FILE & f ) { return f.truncate( f.curPosition()); };
+#endif
+};
+
+typedef FtpFsSdFat FtpFs;
+
+#endif
+
+#endif // FTP_FS_H
@@ -0,0 +1,352 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+FtpFsMount::FtpFsMount()
+{
+  cwdName = "/";
+  truncating = false;
+  #if FTP_RAM_FS_SIZE > 0
+    ramFs = NULL;
+    ramEntry = RamNone;
+  #endif
+}
+
+#if FTP_RAM_FS_SIZE > 0
+void FtpFsMount::begin( const char * _cwdName, FtpRamFs * _ramFs )
+{
+  cwdName = _cwdName;
+  ramFs = _ramFs;
+}
+#else
+void FtpFsMount::begin( const char * _cwdName )
+{
+  cwdName = _cwdName;
+}
+#endif
+
+// Fill the attributes of path
+//
+//  return true if path exists
+
+bool FtpFsMount::stat( const char * path, bool * pisDir, uint64_t * psize,
+                       uint16_t * pdate, uint16_t * ptime )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFs->stat( path, pisDir, psize, pdate, ptime );
+  #endif
+  FTP_FILE f;
+  return FtpFs::stat( f, openPath( f, path ), path, pisDir, psize, pdate, ptime );
+}
+
+bool FtpFsMount::timeStamp( char * path, uint16_t year, uint8_t month, uint8_t day,
+                            uint8_t hour, uint8_t minute, uint8_t second )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFs->timeStamp( path, year, month, day, hour, minute, second );
+  #endif
+  FTP_FILE f;
+
+  return FtpFs::timeStamp( f, ! FtpFs::stampByPath() && openPath( f, path, O_RDWR ),
+                           path, year, month, day, hour, minute, second );
+}
+
+bool FtpFsMount::remove( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFs->remove( path );
+  #endif
+  return FtpFs::remove( path );
+}
+
+bool FtpFsMount::makeDir( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return false;
+  #endif
+  return FtpFs::makeDir( path );
+}
+
+bool FtpFsMount::removeDir( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return false;
+  #endif
+  return FtpFs::removeDir( path );
+}
+
+bool FtpFsMount::rename( const char * path, const char * newpath )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ) || isRam( newpath ))
+      return ramFs->rename( path, newpath );
+  #endif
+  return FtpFs::rename( path, newpath );
+}
+
+// Size and free space in kbytes of the files system holding path
+
+uint32_t FtpFsMount::capacity( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFs->capacity();
+  #endif
+  return FtpFs::capacity();
+}
+
+uint32_t FtpFsMount::free( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFs->free();
+  #endif
+  return FtpFs::free();
+}
+
+// Open the current directory when it is changed. Closed when it may have
+//  been removed or renamed
+
+void FtpFsMount::openCwd()
+{
+  #ifdef FTP_CWD_HANDLE
+    cwdDir.close();
+    if( strlen( cwdName ) > 1 && cwdDir.open( cwdName ) && ! cwdDir.isDir())
+      cwdDir.close();
+  #endif
+}
+
+void FtpFsMount::closeCwd()
+{
+  #ifdef FTP_CWD_HANDLE
+    cwdDir.close();
+  #endif
+}
+
+// Open path, from the current directory if path is inside it
+
+bool FtpFsMount::openPath( FTP_FILE & f, const char * path, int oflag )
+{
+  #ifdef FTP_CWD_HANDLE
+    size_t l = strlen( cwdName );
+    if( cwdDir.isOpen() && ! strncmp( path, cwdName, l ) && path[ l ] == '/' )
+      return f.open( & cwdDir, path + l + 1, oflag );
+  #endif
+  return f.open( path, oflag );
+}
+
+// Open the file of a transfer
+
+bool FtpFsMount::open( const char * path, int oflag )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( isRam( path ))
+      return ramFile.open( ramFs, path, oflag );
+  #endif
+  if( ! openPath( file, path, oflag ))
+    return false;
+  truncating = ( oflag & O_CREAT ) && ! ( oflag & O_APPEND );
+  return true;
+}
+
+int16_t FtpFsMount::read( uint8_t * b, uint16_t nb )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( inRam())
+      return ramFile.read( b, nb );
+  #endif
+  return file.read( b, nb );
+}
+
+size_t FtpFsMount::write( const uint8_t * b, uint16_t nb )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( inRam())
+      return ramFile.write( b, nb );
+  #endif
+  return file.write( b, nb );
+}
+
+bool FtpFsMount::seekSet( uint64_t pos )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( inRam())                        // files in RAM are smaller than 4 GB
+      return pos <= ramFile.fileSize() && ramFile.seekSet( pos );
+  #endif
+  return file.seekSet( pos );
+}
+
+uint64_t FtpFsMount::fileSize()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( inRam())
+      return ramFile.fileSize();
+  #endif
+  return file.fileSize();
+}
+
+// Give contiguous space to the file before it is written. The space left
+//  after its end is released when it is closed
+
+bool FtpFsMount::preAllocate( uint32_t size )
+{
+  if( inRam() || ! FtpFs::preAllocate( file, size ))
+    return false;
+  truncating = true;
+  return true;
+}
+
+void FtpFsMount::close()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    ramFile.close();
+  #endif
+  if( truncating )
+    FtpFs::truncate( file );
+  truncating = false;
+  file.close();
+}
+
+// Open the listing of directory path
+
+bool FtpFsMount::openDir( const char * path )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    ramEntry = RamNone;
+    if( isRam( path ))
+    {
+      if( ! ramFs->mounted())
+        return false;
+      ramEntry = RamBegin;
+      return true;
+    }
+    if( ! strcmp( path, "/" ) && ramFs->mounted())
+      ramEntry = RamRoot;
+  #endif
+  return dir.open( path[ 0 ] == 0 ? "/" : path );
+}
+
+void FtpFsMount::closeDir()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    ramEntry = RamNone;
+  #endif
+  dir.close();
+}
+
+// Entries of the listing opened by openDir()
+
+bool FtpFsMount::nextEntry()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= RamBegin )
+    {
+      ramEntry = ramFs->next( ramEntry );
+      if( ramEntry >= 0 )
+        return true;
+      ramEntry = RamNone;
+      return false;
+    }
+    if( ramEntry == RamMount )
+    {
+      ramEntry = RamNone;
+      return false;
+    }
+    if( FtpFs::nextEntry( dir, file ))
+      return true;
+    if( ramEntry == RamRoot )
+    {
+      ramEntry = RamMount;
+      return true;
+    }
+    return false;
+  #else
+    return FtpFs::nextEntry( dir, file );
+  #endif
+}
+
+bool FtpFsMount::entryIsDir()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= 0 || ramEntry == RamMount )
+      return ramEntry == RamMount;
+  #endif
+  return FtpFs::entryIsDir( dir, file );
+}
+
+uint64_t FtpFsMount::entrySize()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= 0 )
+      return ramFs->fileSize( ramEntry );
+    if( ramEntry == RamMount )
+      return 0;
+  #endif
+  return FtpFs::entrySize( dir, file );
+}
+
+bool FtpFsMount::entryModTime( uint16_t * pdate, uint16_t * ptime )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= 0 )
+    {
+      * pdate = ramFs->fileDate( ramEntry );
+      * ptime = ramFs->fileTime( ramEntry );
+      return true;
+    }
+    bool isDir;
+    uint64_t size;
+    if( ramEntry == RamMount )
+      return ramFs->stat( FTP_RAM_MOUNT, & isDir, & size, pdate, ptime );
+  #endif
+  return FtpFs::entryModTime( dir, file, pdate, ptime );
+}
+
+void FtpFsMount::printEntryName( Print * p )
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= 0 )
+    {
+      p->write( ramFs->fileName( ramEntry ));
+      return;
+    }
+    if( ramEntry == RamMount )
+    {
+      p->write( FTP_RAM_MOUNT + 1 );
+      return;
+    }
+  #endif
+  FtpFs::printEntryName( dir, file, p );
+}
+
+void FtpFsMount::endEntry()
+{
+  #if FTP_RAM_FS_SIZE > 0
+    if( ramEntry >= 0 || ramEntry == RamMount )
+      return;
+  #endif
+  FtpFs::endEntry( dir, file );
+}
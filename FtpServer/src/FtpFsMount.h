@@ -0,0 +1,123 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                         FILES SYSTEMS OF A SESSION                         **
+ **                                                                            **
+ *******************************************************************************/
+
+// A session reaches all its files and directories through FtpFsMount, which
+//  gives each path to the files system holding it: FtpRamFs for the paths
+//  under FTP_RAM_MOUNT, FtpFs for the others. The mount point of RAM is
+//  listed as a directory at the end of the listing of root.
+// A file opened with O_CREAT and without O_APPEND ends at the last byte
+//  written when it is closed, in RAM as in FtpFs, so that STOR replaces a
+//  longer file.
+
+#ifndef FTP_FS_MOUNT_H
+#define FTP_FS_MOUNT_H
+
+class FtpFsMount
+{
+public:
+  FtpFsMount();
+
+#if FTP_RAM_FS_SIZE > 0
+  void     begin( const char * _cwdName, FtpRamFs * _ramFs );
+#else
+  void     begin( const char * _cwdName );
+#endif
+
+  // Operations on paths. Directories can not be created in RAM and files
+  //  can not be moved in or out of it
+  bool     stat( const char * path, bool * pisDir, uint64_t * psize,
+                 uint16_t * pdate, uint16_t * ptime );
+  bool     timeStamp( char * path, uint16_t year, uint8_t month, uint8_t day,
+                      uint8_t hour, uint8_t minute, uint8_t second );
+  bool     remove( const char * path );
+  bool     makeDir( const char * path );
+  bool     removeDir( const char * path );
+  bool     rename( const char * path, const char * newpath );
+  uint32_t capacity( const char * path );
+  uint32_t free( const char * path );
+
+  // Current directory, kept open with FTP_CWD_HANDLE
+  void     openCwd();
+  void     closeCwd();
+
+  // File of a transfer
+  bool     open( const char * path, int oflag = O_READ );
+  int16_t  read( uint8_t * b, uint16_t nb );
+  size_t   write( const uint8_t * b, uint16_t nb );
+  bool     seekSet( uint64_t pos );
+  uint64_t fileSize();
+  bool     preAllocate( uint32_t size );
+  void     close();
+#if FTP_RAM_FS_SIZE > 0
+  bool     inRam() { return ramFile.isOpen(); };
+#else
+  bool     inRam() { return false; };
+#endif
+#ifdef FTP_SENDFILE
+  long     sendFile( FTP_CLIENT & client, uint32_t size )
+             { return inRam() ? -1 : client.sendFile( file, size ); };
+#endif
+
+  // Directory listed
+  bool     openDir( const char * path );
+  bool     nextEntry();
+  bool     entryIsDir();
+  uint64_t entrySize();
+  bool     entryModTime( uint16_t * pdate, uint16_t * ptime );
+  void     printEntryName( Print * p );
+  void     endEntry();
+  void     closeDir();
+#if FTP_RAM_FS_SIZE > 0
+  bool     dirInRam() { return ramEntry >= RamBegin; };
+#else
+  bool     dirInRam() { return false; };
+#endif
+
+private:
+  bool     openPath( FTP_FILE & f, const char * path, int oflag = O_READ );
+#if FTP_RAM_FS_SIZE > 0
+  static bool isRam( const char * path ) { return FtpRamFs::name( path ) != NULL; };
+#endif
+
+  const char * cwdName;               // current directory of the session
+  FTP_FILE     file;                  // file of transfer
+  FTP_DIR      dir;                   // directory listed
+  #ifdef FTP_CWD_HANDLE
+  FTP_DIR      cwdDir;                // current directory, kept open
+  #endif
+  bool         truncating;            // file ends at its position when closed
+  #if FTP_RAM_FS_SIZE > 0
+  enum { RamNone = -4,                // listing is not in RAM
+         RamRoot,                     // listing of root, ending with mount point
+         RamMount,                    // mount point is the entry listed
+         RamBegin };                  // listing of RAM, before its first file
+  FtpRamFs *   ramFs;
+  FtpRamFile   ramFile;               // file of transfer when it is in RAM
+  int8_t       ramEntry;              // file of RAM listed, or one of above
+  #endif
+};
+
+#endif // FTP_FS_MOUNT_H
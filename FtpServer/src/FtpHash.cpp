@@ -0,0 +1,341 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+// CRC-32 of Ethernet, zip and zlib (reflected polynomial 0xedb88320)
+
+static const uint32_t crcTable[ 256 ] = {
+  0x00000000UL, 0x77073096UL, 0xee0e612cUL, 0x990951baUL, 0x076dc419UL, 0x706af48fUL,
+  0xe963a535UL, 0x9e6495a3UL, 0x0edb8832UL, 0x79dcb8a4UL, 0xe0d5e91eUL, 0x97d2d988UL,
+  0x09b64c2bUL, 0x7eb17cbdUL, 0xe7b82d07UL, 0x90bf1d91UL, 0x1db71064UL, 0x6ab020f2UL,
+  0xf3b97148UL, 0x84be41deUL, 0x1adad47dUL, 0x6ddde4ebUL, 0xf4d4b551UL, 0x83d385c7UL,
+  0x136c9856UL, 0x646ba8c0UL, 0xfd62f97aUL, 0x8a65c9ecUL, 0x14015c4fUL, 0x63066cd9UL,
+  0xfa0f3d63UL, 0x8d080df5UL, 0x3b6e20c8UL, 0x4c69105eUL, 0xd56041e4UL, 0xa2677172UL,
+  0x3c03e4d1UL, 0x4b04d447UL, 0xd20d85fdUL, 0xa50ab56bUL, 0x35b5a8faUL, 0x42b2986cUL,
+  0xdbbbc9d6UL, 0xacbcf940UL, 0x32d86ce3UL, 0x45df5c75UL, 0xdcd60dcfUL, 0xabd13d59UL,
+  0x26d930acUL, 0x51de003aUL, 0xc8d75180UL, 0xbfd06116UL, 0x21b4f4b5UL, 0x56b3c423UL,
+  0xcfba9599UL, 0xb8bda50fUL, 0x2802b89eUL, 0x5f058808UL, 0xc60cd9b2UL, 0xb10be924UL,
+  0x2f6f7c87UL, 0x58684c11UL, 0xc1611dabUL, 0xb6662d3dUL, 0x76dc4190UL, 0x01db7106UL,
+  0x98d220bcUL, 0xefd5102aUL, 0x71b18589UL, 0x06b6b51fUL, 0x9fbfe4a5UL, 0xe8b8d433UL,
+  0x7807c9a2UL, 0x0f00f934UL, 0x9609a88eUL, 0xe10e9818UL, 0x7f6a0dbbUL, 0x086d3d2dUL,
+  0x91646c97UL, 0xe6635c01UL, 0x6b6b51f4UL, 0x1c6c6162UL, 0x856530d8UL, 0xf262004eUL,
+  0x6c0695edUL, 0x1b01a57bUL, 0x8208f4c1UL, 0xf50fc457UL, 0x65b0d9c6UL, 0x12b7e950UL,
+  0x8bbeb8eaUL, 0xfcb9887cUL, 0x62dd1ddfUL, 0x15da2d49UL, 0x8cd37cf3UL, 0xfbd44c65UL,
+  0x4db26158UL, 0x3ab551ceUL, 0xa3bc0074UL, 0xd4bb30e2UL, 0x4adfa541UL, 0x3dd895d7UL,
+  0xa4d1c46dUL, 0xd3d6f4fbUL, 0x4369e96aUL, 0x346ed9fcUL, 0xad678846UL, 0xda60b8d0UL,
+  0x44042d73UL, 0x33031de5UL, 0xaa0a4c5fUL, 0xdd0d7cc9UL, 0x5005713cUL, 0x270241aaUL,
+  0xbe0b1010UL, 0xc90c2086UL, 0x5768b525UL, 0x206f85b3UL, 0xb966d409UL, 0xce61e49fUL,
+  0x5edef90eUL, 0x29d9c998UL, 0xb0d09822UL, 0xc7d7a8b4UL, 0x59b33d17UL, 0x2eb40d81UL,
+  0xb7bd5c3bUL, 0xc0ba6cadUL, 0xedb88320UL, 0x9abfb3b6UL, 0x03b6e20cUL, 0x74b1d29aUL,
+  0xead54739UL, 0x9dd277afUL, 0x04db2615UL, 0x73dc1683UL, 0xe3630b12UL, 0x94643b84UL,
+  0x0d6d6a3eUL, 0x7a6a5aa8UL, 0xe40ecf0bUL, 0x9309ff9dUL, 0x0a00ae27UL, 0x7d079eb1UL,
+  0xf00f9344UL, 0x8708a3d2UL, 0x1e01f268UL, 0x6906c2feUL, 0xf762575dUL, 0x806567cbUL,
+  0x196c3671UL, 0x6e6b06e7UL, 0xfed41b76UL, 0x89d32be0UL, 0x10da7a5aUL, 0x67dd4accUL,
+  0xf9b9df6fUL, 0x8ebeeff9UL, 0x17b7be43UL, 0x60b08ed5UL, 0xd6d6a3e8UL, 0xa1d1937eUL,
+  0x38d8c2c4UL, 0x4fdff252UL, 0xd1bb67f1UL, 0xa6bc5767UL, 0x3fb506ddUL, 0x48b2364bUL,
+  0xd80d2bdaUL, 0xaf0a1b4cUL, 0x36034af6UL, 0x41047a60UL, 0xdf60efc3UL, 0xa867df55UL,
+  0x316e8eefUL, 0x4669be79UL, 0xcb61b38cUL, 0xbc66831aUL, 0x256fd2a0UL, 0x5268e236UL,
+  0xcc0c7795UL, 0xbb0b4703UL, 0x220216b9UL, 0x5505262fUL, 0xc5ba3bbeUL, 0xb2bd0b28UL,
+  0x2bb45a92UL, 0x5cb36a04UL, 0xc2d7ffa7UL, 0xb5d0cf31UL, 0x2cd99e8bUL, 0x5bdeae1dUL,
+  0x9b64c2b0UL, 0xec63f226UL, 0x756aa39cUL, 0x026d930aUL, 0x9c0906a9UL, 0xeb0e363fUL,
+  0x72076785UL, 0x05005713UL, 0x95bf4a82UL, 0xe2b87a14UL, 0x7bb12baeUL, 0x0cb61b38UL,
+  0x92d28e9bUL, 0xe5d5be0dUL, 0x7cdcefb7UL, 0x0bdbdf21UL, 0x86d3d2d4UL, 0xf1d4e242UL,
+  0x68ddb3f8UL, 0x1fda836eUL, 0x81be16cdUL, 0xf6b9265bUL, 0x6fb077e1UL, 0x18b74777UL,
+  0x88085ae6UL, 0xff0f6a70UL, 0x66063bcaUL, 0x11010b5cUL, 0x8f659effUL, 0xf862ae69UL,
+  0x616bffd3UL, 0x166ccf45UL, 0xa00ae278UL, 0xd70dd2eeUL, 0x4e048354UL, 0x3903b3c2UL,
+  0xa7672661UL, 0xd06016f7UL, 0x4969474dUL, 0x3e6e77dbUL, 0xaed16a4aUL, 0xd9d65adcUL,
+  0x40df0b66UL, 0x37d83bf0UL, 0xa9bcae53UL, 0xdebb9ec5UL, 0x47b2cf7fUL, 0x30b5ffe9UL,
+  0xbdbdf21cUL, 0xcabac28aUL, 0x53b39330UL, 0x24b4a3a6UL, 0xbad03605UL, 0xcdd70693UL,
+  0x54de5729UL, 0x23d967bfUL, 0xb3667a2eUL, 0xc4614ab8UL, 0x5d681b02UL, 0x2a6f2b94UL,
+  0xb40bbe37UL, 0xc30c8ea1UL, 0x5a05df1bUL, 0x2d02ef8dUL
+};
+
+#ifdef FTP_CRC_SLICE8
+// crcSlice[ k ][ i ] is the CRC of byte i followed by k zero bytes
+static uint32_t crcSlice[ 8 ][ 256 ];
+static bool     crcSliceReady = false;
+#endif
+
+// Constants and shifts of the rounds of MD5 (RFC 1321)
+
+static const uint32_t md5K[ 64 ] = {
+  0xd76aa478UL, 0xe8c7b756UL, 0x242070dbUL, 0xc1bdceeeUL, 0xf57c0fafUL, 0x4787c62aUL,
+  0xa8304613UL, 0xfd469501UL, 0x698098d8UL, 0x8b44f7afUL, 0xffff5bb1UL, 0x895cd7beUL,
+  0x6b901122UL, 0xfd987193UL, 0xa679438eUL, 0x49b40821UL, 0xf61e2562UL, 0xc040b340UL,
+  0x265e5a51UL, 0xe9b6c7aaUL, 0xd62f105dUL, 0x02441453UL, 0xd8a1e681UL, 0xe7d3fbc8UL,
+  0x21e1cde6UL, 0xc33707d6UL, 0xf4d50d87UL, 0x455a14edUL, 0xa9e3e905UL, 0xfcefa3f8UL,
+  0x676f02d9UL, 0x8d2a4c8aUL, 0xfffa3942UL, 0x8771f681UL, 0x6d9d6122UL, 0xfde5380cUL,
+  0xa4beea44UL, 0x4bdecfa9UL, 0xf6bb4b60UL, 0xbebfbc70UL, 0x289b7ec6UL, 0xeaa127faUL,
+  0xd4ef3085UL, 0x04881d05UL, 0xd9d4d039UL, 0xe6db99e5UL, 0x1fa27cf8UL, 0xc4ac5665UL,
+  0xf4292244UL, 0x432aff97UL, 0xab9423a7UL, 0xfc93a039UL, 0x655b59c3UL, 0x8f0ccc92UL,
+  0xffeff47dUL, 0x85845dd1UL, 0x6fa87e4fUL, 0xfe2ce6e0UL, 0xa3014314UL, 0x4e0811a1UL,
+  0xf7537e82UL, 0xbd3af235UL, 0x2ad7d2bbUL, 0xeb86d391UL
+};
+static const uint8_t md5S[ 16 ] = {
+  7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+static const char * hashNames[ FtpHash::Count ] = { "CRC32", "MD5", "SHA-1" };
+
+static inline uint32_t rol( uint32_t x, uint8_t n )
+{
+  return ( x << n ) | ( x >> ( 32 - n ));
+}
+
+void FtpHash::begin( uint8_t _alg )
+{
+  alg = _alg;
+  nbBlock = 0;
+  length = 0;
+  if( alg == CRC32 )
+    h[ 0 ] = 0;
+  else                                  // MD5 and SHA-1 begin with the same values
+  {
+    h[ 0 ] = 0x67452301UL;
+    h[ 1 ] = 0xefcdab89UL;
+    h[ 2 ] = 0x98badcfeUL;
+    h[ 3 ] = 0x10325476UL;
+    h[ 4 ] = 0xc3d2e1f0UL;
+  }
+}
+
+void FtpHash::update( const uint8_t * b, uint32_t nb )
+{
+  if( alg == CRC32 )
+  {
+    h[ 0 ] = crc32( h[ 0 ], b, nb );
+    return;
+  }
+  length += nb;
+  while( nb > 0 )
+  {
+    uint32_t n = 64u - nbBlock < nb ? 64u - nbBlock : nb;
+    memcpy( block + nbBlock, b, n );
+    nbBlock += n;
+    b += n;
+    nb -= n;
+    if( nbBlock == 64 )
+      transform();
+  }
+}
+
+// Terminate the digest and write it in hexadecimal to hex, which must
+//  have room for FTP_HASH_HEX_SIZE chars
+//
+//  return hex
+
+char * FtpHash::end( char * hex, bool upper )
+{
+  if( alg == CRC32 )
+    return crcHex( h[ 0 ], hex, upper );
+
+  uint64_t bits = length << 3;
+  block[ nbBlock ++ ] = 0x80;
+  if( nbBlock > 56 )
+  {
+    memset( block + nbBlock, 0, 64 - nbBlock );
+    transform();
+  }
+  memset( block + nbBlock, 0, 56 - nbBlock );
+  for( uint8_t i = 0; i < 8; i ++ )     // MD5 is little endian, SHA-1 big endian
+    block[ alg == MD5 ? 56 + i : 63 - i ] = bits >> ( 8 * i );
+  transform();
+
+  const char * digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  uint8_t nd = alg == MD5 ? 16 : 20;
+  for( uint8_t i = 0; i < nd; i ++ )
+  {
+    uint8_t d = alg == MD5 ? h[ i / 4 ] >> ( 8 * ( i % 4 ))
+                           : h[ i / 4 ] >> ( 24 - 8 * ( i % 4 ));
+    hex[ 2 * i ] = digits[ d >> 4 ];
+    hex[ 2 * i + 1 ] = digits[ d & 0x0f ];
+  }
+  hex[ 2 * nd ] = 0;
+  return hex;
+}
+
+// Update crc with nb bytes. Start with crc = 0
+
+uint32_t FtpHash::crc32( uint32_t crc, const uint8_t * b, uint32_t nb )
+{
+  crc = ~ crc;
+  #ifdef FTP_CRC_SLICE8
+    if( ! crcSliceReady )
+    {
+      memcpy( crcSlice[ 0 ], crcTable, sizeof( crcTable ));
+      for( uint8_t k = 1; k < 8; k ++ )
+        for( uint16_t i = 0; i < 256; i ++ )
+          crcSlice[ k ][ i ] = ( crcSlice[ k - 1 ][ i ] >> 8 ) ^
+                               crcTable[ crcSlice[ k - 1 ][ i ] & 0xff ];
+      crcSliceReady = true;
+    }
+    while( nb >= 8 )
+    {
+      uint32_t a = crc ^ ( b[ 0 ] | b[ 1 ] << 8 | b[ 2 ] << 16 | (uint32_t) b[ 3 ] << 24 );
+      crc = crcSlice[ 7 ][ a & 0xff ] ^ crcSlice[ 6 ][ ( a >> 8 ) & 0xff ] ^
+            crcSlice[ 5 ][ ( a >> 16 ) & 0xff ] ^ crcSlice[ 4 ][ a >> 24 ] ^
+            crcSlice[ 3 ][ b[ 4 ]] ^ crcSlice[ 2 ][ b[ 5 ]] ^
+            crcSlice[ 1 ][ b[ 6 ]] ^ crcSlice[ 0 ][ b[ 7 ]];
+      b += 8;
+      nb -= 8;
+    }
+  #endif
+  while( nb -- > 0 )
+    crc = ( crc >> 8 ) ^ crcTable[ ( crc ^ * b ++ ) & 0xff ];
+  return ~ crc;
+}
+
+// Write crc as 8 hexadecimal digits
+
+char * FtpHash::crcHex( uint32_t crc, char * hex, bool upper )
+{
+  const char * digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  for( uint8_t i = 0; i < 8; i ++ )
+    hex[ i ] = digits[ ( crc >> ( 28 - 4 * i )) & 0x0f ];
+  hex[ 8 ] = 0;
+  return hex;
+}
+
+const char * FtpHash::name( uint8_t alg )
+{
+  return alg < Count ? hashNames[ alg ] : "";
+}
+
+// Return the algorithm named name (case is ignored), or -1
+
+int8_t FtpHash::find( const char * name )
+{
+  for( int8_t alg = 0; alg < Count; alg ++ )
+  {
+    const char * p = hashNames[ alg ];
+    const char * q = name;
+    while( * p != 0 && toupper( * q ) == * p )
+    {
+      p ++;
+      q ++;
+    }
+    if( * p == 0 && * q == 0 )
+      return alg;
+  }
+  return -1;
+}
+
+// Process the 64 bytes of block
+
+void FtpHash::transform()
+{
+  if( alg == MD5 )
+    md5Block();
+  else
+    sha1Block();
+  nbBlock = 0;
+}
+
+void FtpHash::md5Block()
+{
+  uint32_t w[ 16 ];
+  for( uint8_t i = 0; i < 16; i ++ )
+    w[ i ] = block[ 4 * i ] | block[ 4 * i + 1 ] << 8 |
+             block[ 4 * i + 2 ] << 16 | (uint32_t) block[ 4 * i + 3 ] << 24;
+  uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ];
+  for( uint8_t i = 0; i < 64; i ++ )
+  {
+    uint32_t f;
+    uint8_t  g;
+    if( i < 16 )
+    {
+      f = ( b & c ) | ( ~ b & d );
+      g = i;
+    }
+    else if( i < 32 )
+    {
+      f = ( d & b ) | ( ~ d & c );
+      g = ( 5 * i + 1 ) & 15;
+    }
+    else if( i < 48 )
+    {
+      f = b ^ c ^ d;
+      g = ( 3 * i + 5 ) & 15;
+    }
+    else
+    {
+      f = c ^ ( b | ~ d );
+      g = ( 7 * i ) & 15;
+    }
+    f += a + md5K[ i ] + w[ g ];
+    a = d;
+    d = c;
+    c = b;
+    b += rol( f, md5S[ ( i >> 4 ) * 4 + ( i & 3 )]);
+  }
+  h[ 0 ] += a;
+  h[ 1 ] += b;
+  h[ 2 ] += c;
+  h[ 3 ] += d;
+}
+
+// The 80 words of the message schedule are kept in a ring of 16 words
+
+void FtpHash::sha1Block()
+{
+  uint32_t w[ 16 ];
+  for( uint8_t i = 0; i < 16; i ++ )
+    w[ i ] = (uint32_t) block[ 4 * i ] << 24 | block[ 4 * i + 1 ] << 16 |
+             block[ 4 * i + 2 ] << 8 | block[ 4 * i + 3 ];
+  uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ], e = h[ 4 ];
+  for( uint8_t i = 0; i < 80; i ++ )
+  {
+    if( i >= 16 )
+      w[ i & 15 ] = rol( w[ ( i + 13 ) & 15 ] ^ w[ ( i + 8 ) & 15 ] ^
+                         w[ ( i + 2 ) & 15 ] ^ w[ i & 15 ], 1 );
+    uint32_t f, k;
+    if( i < 20 )
+    {
+      f = ( b & c ) | ( ~ b & d );
+      k = 0x5a827999UL;
+    }
+    else if( i < 40 )
+    {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1UL;
+    }
+    else if( i < 60 )
+    {
+      f = ( b & c ) | ( b & d ) | ( c & d );
+      k = 0x8f1bbcdcUL;
+    }
+    else
+    {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6UL;
+    }
+    uint32_t t = rol( a, 5 ) + f + e + k + w[ i & 15 ];
+    e = d;
+    d = c;
+    c = rol( b, 30 );
+    b = a;
+    a = t;
+  }
+  h[ 0 ] += a;
+  h[ 1 ] += b;
+  h[ 2 ] += c;
+  h[ 3 ] += d;
+  h[ 4 ] += e;
+}
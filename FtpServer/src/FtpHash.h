@@ -0,0 +1,63 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                        CHECKSUMS OF FILES                                  **
+ **                                                                            **
+ *******************************************************************************/
+
+// Digests computed by HASH, XCRC, XMD5 and XSHA1, and CRC-32 of uploads.
+// Data is given by parts of any size to update(). CRC-32 is table driven,
+//  by 8 bytes at once if FTP_CRC_SLICE8 is defined.
+
+#ifndef FTP_HASH_H
+#define FTP_HASH_H
+
+#define FTP_HASH_HEX_SIZE 41          // size of the longest digest in hex (SHA-1)
+
+class FtpHash
+{
+public:
+  enum { CRC32 = 0, MD5, SHA1, Count };
+
+  void   begin( uint8_t _alg );
+  void   update( const uint8_t * b, uint32_t nb );
+  char * end( char * hex, bool upper = false );
+  uint8_t algorithm() { return alg; };
+
+  static uint32_t crc32( uint32_t crc, const uint8_t * b, uint32_t nb );
+  static char * crcHex( uint32_t crc, char * hex, bool upper = true );
+  static const char * name( uint8_t alg );
+  static int8_t find( const char * name );
+
+private:
+  void     transform();
+  void     md5Block();
+  void     sha1Block();
+
+  uint8_t  alg;
+  uint32_t h[ 5 ];                    // state of digest (h[ 0 ] for CRC-32)
+  uint8_t  nbBlock;                   // bytes in block
+  uint64_t length;                    // bytes hashed
+  uint8_t  block[ 64 ];               // bytes waiting for a whole block
+};
+
+#endif // FTP_HASH_H
@@ -0,0 +1,243 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+#if FTP_LIST_CACHE_SIZE > 0
+
+FtpListCache::FtpListCache()
+{
+  memset( slots, 0, sizeof( slots ));
+  used = 0;
+  useCount = 0;
+}
+
+// Return the slot where listing of type for dir is ready, or -1
+//  The slot must be released when it has been sent
+
+int8_t FtpListCache::find( const char * dir, uint8_t type )
+{
+  uint32_t hash = hashOf( dir, strlen( dir ));
+  for( int8_t i = 0; i < FTP_LIST_CACHE_SLOTS; i ++ )
+  {
+    Slot & s = slots[ i ];
+    if( s.state == Ready && s.type == type && s.hash == hash &&
+        ftpSamePath( s.dir, dir, strlen( dir ) + 1 ))
+    {
+      s.users ++;
+      s.lastUse = ++ useCount;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void FtpListCache::release( int8_t slot )
+{
+  Slot & s = slots[ slot ];
+  if( s.users > 0 )
+    s.users --;
+  if( s.state == Stale && s.users == 0 )
+    freeSlot( slot );
+}
+
+// Reserve a slot to store listing of type for dir
+//
+//  return -1 if no slot is available
+
+int8_t FtpListCache::fill( const char * dir, uint8_t type )
+{
+  int8_t slot = -1;
+  for( int8_t i = 0; i < FTP_LIST_CACHE_SLOTS; i ++ )
+    if( slots[ i ].state == Free )
+    {
+      slot = i;
+      break;
+    }
+  if( slot < 0 && evict( -1 ))
+    return fill( dir, type );
+  if( slot < 0 )
+    return -1;
+  Slot & s = slots[ slot ];
+  s.dir = strdup( dir );
+  if( s.dir == NULL )
+    return -1;
+  s.hash = hashOf( dir, strlen( dir ));
+  s.type = type;
+  s.size = 0;
+  s.nbMatch = 0;
+  s.users = 0;
+  s.state = Filling;
+  return slot;
+}
+
+// Add nb bytes of listing to slot
+//  The memory of slot grows by steps of 1 kbytes. Other listings are
+//  removed if needed. If the listing is too large, slot is freed
+//
+//  return false if slot was freed
+
+bool FtpListCache::append( int8_t slot, const uint8_t * b, uint16_t nb )
+{
+  Slot & s = slots[ slot ];
+  if( s.state != Filling )
+  {
+    freeSlot( slot );
+    return false;
+  }
+  if( s.size + nb > s.capacity )
+  {
+    uint32_t capacity = ( s.size + nb + 1023 ) & ~ 1023UL;
+    while( used - s.capacity + capacity > FTP_LIST_CACHE_SIZE )
+      if( ! evict( slot ))
+      {
+        freeSlot( slot );
+        return false;
+      }
+    uint8_t * p = (uint8_t *) FTP_LIST_CACHE_REALLOC( s.pdata, capacity );
+    if( p == NULL )
+    {
+      freeSlot( slot );
+      return false;
+    }
+    used += capacity - s.capacity;
+    s.pdata = p;
+    s.capacity = capacity;
+  }
+  memcpy( s.pdata + s.size, b, nb );
+  s.size += nb;
+  return true;
+}
+
+// Listing is complete. It is kept only if no file of the directory
+//  was changed while it was read
+
+void FtpListCache::commit( int8_t slot, uint16_t nbMatch )
+{
+  Slot & s = slots[ slot ];
+  if( s.state != Filling )
+  {
+    freeSlot( slot );
+    return;
+  }
+  s.nbMatch = nbMatch;
+  s.lastUse = ++ useCount;
+  s.state = Ready;
+}
+
+void FtpListCache::cancel( int8_t slot )
+{
+  freeSlot( slot );
+}
+
+// A file or directory was changed: remove listing of the directory that
+//  contains path, and listings of path and its subdirectories
+
+void FtpListCache::invalidate( const char * path )
+{
+  const char * psep = strrchr( path, '/' );
+  size_t lpar = psep == NULL ? 0 : psep - path;
+  size_t lpath = strlen( path );
+  for( int8_t i = 0; i < FTP_LIST_CACHE_SLOTS; i ++ )
+  {
+    Slot & s = slots[ i ];
+    if( s.state == Free || s.state == Stale )
+      continue;
+    size_t ldir = strlen( s.dir );
+    bool parent = lpar == 0 ? ! strcmp( s.dir, "/" )
+                            : ldir == lpar && ftpSamePath( s.dir, path, lpar );
+    bool inside = ldir >= lpath && ftpSamePath( s.dir, path, lpath ) &&
+                  ( s.dir[ lpath ] == 0 || s.dir[ lpath ] == '/' );
+    if( parent || inside )
+      remove( i );
+  }
+}
+
+// Remove listing of the directory with hash given by dirHash()
+
+void FtpListCache::invalidateDir( uint32_t hash )
+{
+  for( int8_t i = 0; i < FTP_LIST_CACHE_SLOTS; i ++ )
+    if(( slots[ i ].state == Filling || slots[ i ].state == Ready ) &&
+        slots[ i ].hash == hash )
+      remove( i );
+}
+
+// Return the hash of the directory that contains path
+
+uint32_t FtpListCache::dirHash( const char * path )
+{
+  const char * psep = strrchr( path, '/' );
+  if( psep == NULL || psep == path )
+    return hashOf( "/", 1 );
+  return hashOf( path, psep - path );
+}
+
+// FNV-1a hash of the n first chars of s, ignoring case if the files system does
+
+uint32_t FtpListCache::hashOf( const char * s, size_t n )
+{
+  bool cs = FtpFs::caseSensitive();
+  uint32_t h = 2166136261UL;
+  while( n -- > 0 && * s != 0 )
+  {
+    uint8_t c = * s ++;
+    h = ( h ^ ( cs ? c : tolower( c ))) * 16777619UL;
+  }
+  return h;
+}
+
+// Remove listing of slot, now or when it is no more used
+
+void FtpListCache::remove( int8_t slot )
+{
+  if( slots[ slot ].users > 0 || slots[ slot ].state == Filling )
+    slots[ slot ].state = Stale;
+  else
+    freeSlot( slot );
+}
+
+void FtpListCache::freeSlot( int8_t slot )
+{
+  Slot & s = slots[ slot ];
+  ::free( s.dir );
+  ::free( s.pdata );
+  used -= s.capacity;
+  memset( & s, 0, sizeof( s ));
+}
+
+// Free the least recently used listing that is not being sent
+//
+//  return false if there is none
+
+bool FtpListCache::evict( int8_t except )
+{
+  int8_t lru = -1;
+  for( int8_t i = 0; i < FTP_LIST_CACHE_SLOTS; i ++ )
+    if( i != except && slots[ i ].state == Ready && slots[ i ].users == 0 &&
+        ( lru < 0 || slots[ i ].lastUse < slots[ lru ].lastUse ))
+      lru = i;
+  if( lru < 0 )
+    return false;
+  freeSlot( lru );
+  return true;
+}
+
+#endif // FTP_LIST_CACHE_SIZE > 0
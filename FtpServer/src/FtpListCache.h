@@ -0,0 +1,89 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                     CACHE OF DIRECTORY LISTINGS                            **
+ **                                                                            **
+ *******************************************************************************/
+
+// Listings (LIST, NLST, MLSD) are stored as they are sent to the client,
+//  keyed by directory and type of listing. A listing that is in the cache
+//  is sent again without reading the directory.
+// Any change of a file (DELE, STOR, MKD, RMD, RNTO, MFMT) removes the
+//  listing of the directory that contains it.
+// A slot is used by one session that fills it, or by the sessions that
+//  send it. A slot that is removed while used is freed when released.
+
+#ifndef FTP_LIST_CACHE_H
+#define FTP_LIST_CACHE_H
+
+#if FTP_LIST_CACHE_SIZE > 0
+
+class FtpListCache
+{
+public:
+  FtpListCache();
+
+  int8_t   find( const char * dir, uint8_t type );
+  void     release( int8_t slot );
+  const uint8_t * data( int8_t slot ) { return slots[ slot ].pdata; };
+  uint32_t size( int8_t slot ) { return slots[ slot ].size; };
+  uint16_t matches( int8_t slot ) { return slots[ slot ].nbMatch; };
+
+  int8_t   fill( const char * dir, uint8_t type );
+  bool     append( int8_t slot, const uint8_t * b, uint16_t nb );
+  void     commit( int8_t slot, uint16_t nbMatch );
+  void     cancel( int8_t slot );
+
+  void     invalidate( const char * path );
+  void     invalidateDir( uint32_t hash );
+  uint32_t dirHash( const char * path );
+
+private:
+  enum { Free = 0, Filling, Ready, Stale };
+
+  struct Slot
+  {
+    char *   dir;                     // directory listed
+    uint32_t hash;                    // hash of dir
+    uint8_t * pdata;                  // listing as sent to the client
+    uint32_t size,                    // bytes in pdata
+             capacity,                // bytes allocated for pdata
+             lastUse;
+    uint16_t nbMatch;                 // number of entries
+    uint8_t  type,                    // type of listing
+             state,
+             users;                   // number of sessions sending this listing
+  };
+
+  uint32_t hashOf( const char * s, size_t n );
+  void     remove( int8_t slot );
+  void     freeSlot( int8_t slot );
+  bool     evict( int8_t except );
+
+  Slot     slots[ FTP_LIST_CACHE_SLOTS ];
+  uint32_t used,                      // bytes allocated for all slots
+           useCount;
+};
+
+#endif // FTP_LIST_CACHE_SIZE > 0
+
+#endif // FTP_LIST_CACHE_H
@@ -0,0 +1,396 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+#if FTP_RAM_FS_SIZE > 0
+
+#define FTP_RAM_DATE ( 20 << 9 | 1 << 5 | 1 ) // 2000-01-01 when there is no clock
+
+void ( * FtpRamFs::dateTime )( uint16_t * date, uint16_t * time ) = NULL;
+
+// Allocate the pool
+//
+//  return false if there is not enough memory
+
+bool FtpRamFs::begin()
+{
+  if( pool != NULL )
+    return true;
+  nbBlocks = FTP_RAM_FS_SIZE / FTP_RAM_BLOCK < NONE ? FTP_RAM_FS_SIZE / FTP_RAM_BLOCK : NONE - 1;
+  pool = (uint8_t *) FTP_RAM_MALLOC( (uint32_t) nbBlocks * ( FTP_RAM_BLOCK + sizeof( uint16_t )));
+  if( pool == NULL )
+    return false;
+  nextBlock = (uint16_t *) ( pool + (uint32_t) nbBlocks * FTP_RAM_BLOCK );
+  for( uint16_t b = 0; b < nbBlocks; b ++ )
+    nextBlock[ b ] = b + 1 < nbBlocks ? b + 1 : NONE;
+  freeBlock = 0;
+  nbFree = nbBlocks;
+  memset( files, 0, sizeof( files ));
+  memset( index, -1, sizeof( index ));
+  now( & mountDate, & mountTime );
+  return true;
+}
+
+// Return the name in RAM of path, "" for the mount point itself,
+//  or NULL if path is not under the mount point
+
+const char * FtpRamFs::name( const char * path )
+{
+  size_t l = strlen( FTP_RAM_MOUNT );
+  if( strncmp( path, FTP_RAM_MOUNT, l ))
+    return NULL;
+  if( path[ l ] == 0 )
+    return path + l;
+  if( path[ l ] != '/' )
+    return NULL;
+  return path + l + 1;
+}
+
+bool FtpRamFs::stat( const char * path, bool * pisDir, uint64_t * psize,
+                     uint16_t * pdate, uint16_t * ptime )
+{
+  const char * n = name( path );
+  if( n == NULL || pool == NULL )
+    return false;
+  if( * n == 0 )
+  {
+    * pisDir = true;
+    * pdate = mountDate;
+    * ptime = mountTime;
+    return true;
+  }
+  uint8_t i;
+  int8_t slot = lookup( n, & i );
+  if( slot < 0 )
+    return false;
+  * pisDir = false;
+  * psize = files[ slot ].size;
+  * pdate = files[ slot ].date;
+  * ptime = files[ slot ].time;
+  return true;
+}
+
+bool FtpRamFs::remove( const char * path )
+{
+  const char * n = name( path );
+  uint8_t i;
+  int8_t slot = n == NULL || pool == NULL ? -1 : lookup( n, & i );
+  if( slot < 0 || files[ slot ].readers > 0 || files[ slot ].writer )
+    return false;
+  freeBlocks( files[ slot ].first );
+  unindex( i );
+  files[ slot ].name[ 0 ] = 0;
+  return true;
+}
+
+// Rename a file. Files can not be moved out of RAM and are not replaced
+
+bool FtpRamFs::rename( const char * path, const char * newpath )
+{
+  const char * n = name( path );
+  const char * nn = name( newpath );
+  uint8_t i, j;
+  if( n == NULL || nn == NULL || pool == NULL || * nn == 0 ||
+      strlen( nn ) >= FTP_RAM_NAME || strchr( nn, '/' ) != NULL )
+    return false;
+  int8_t slot = lookup( n, & i );
+  if( slot < 0 || files[ slot ].readers > 0 || files[ slot ].writer || lookup( nn, & j ) >= 0 )
+    return false;
+  unindex( i );
+  strcpy( files[ slot ].name, nn );
+  files[ slot ].hash = hashOf( nn );
+  lookup( nn, & j );
+  index[ j ] = slot;
+  return true;
+}
+
+bool FtpRamFs::timeStamp( const char * path, uint16_t year, uint8_t month, uint8_t day,
+                          uint8_t hour, uint8_t minute, uint8_t second )
+{
+  const char * n = name( path );
+  uint8_t i;
+  int8_t slot = n == NULL || pool == NULL ? -1 : lookup( n, & i );
+  if( slot < 0 )
+    return false;
+  files[ slot ].date = ( year - 1980 ) << 9 | month << 5 | day;
+  files[ slot ].time = hour << 11 | minute << 5 | second >> 1;
+  return true;
+}
+
+// Return the first file after slot (-1 to begin), or -1 if there is none
+
+int8_t FtpRamFs::next( int8_t slot )
+{
+  while( ++ slot < FTP_RAM_FILES )
+    if( files[ slot ].name[ 0 ] != 0 )
+      return slot;
+  return -1;
+}
+
+uint32_t FtpRamFs::hashOf( const char * name )
+{
+  uint32_t hash = 2166136261UL;         // FNV-1a
+  while( * name != 0 )
+    hash = ( hash ^ (uint8_t) * name ++ ) * 16777619UL;
+  return hash;
+}
+
+// Return the file named name, or -1. pi receives the position of name
+//  in index, or the position where it would be inserted
+
+int8_t FtpRamFs::lookup( const char * name, uint8_t * pi )
+{
+  uint32_t hash = hashOf( name );
+  uint8_t i = hash % FTP_RAM_INDEX;
+  while( index[ i ] >= 0 )
+  {
+    File & f = files[ index[ i ]];
+    if( f.hash == hash && ! strcmp( f.name, name ))
+      break;
+    i = ( i + 1 ) % FTP_RAM_INDEX;
+  }
+  * pi = i;
+  return index[ i ];
+}
+
+// Remove position i of index, moving back the next entries that
+//  could not be stored at their own position
+
+void FtpRamFs::unindex( uint8_t i )
+{
+  uint8_t j = i;
+  index[ i ] = -1;
+  while( true )
+  {
+    j = ( j + 1 ) % FTP_RAM_INDEX;
+    if( index[ j ] < 0 )
+      return;
+    uint8_t k = files[ index[ j ]].hash % FTP_RAM_INDEX;
+    if( i <= j ? i < k && k <= j : i < k || k <= j )
+      continue;
+    index[ i ] = index[ j ];
+    index[ j ] = -1;
+    i = j;
+  }
+}
+
+// Add an empty file
+//
+//  return -1 if name is not valid or there is no free entry
+
+int8_t FtpRamFs::create( const char * name )
+{
+  uint8_t i;
+  if( * name == 0 || strlen( name ) >= FTP_RAM_NAME || strchr( name, '/' ) != NULL ||
+      lookup( name, & i ) >= 0 )
+    return -1;
+  for( int8_t slot = 0; slot < FTP_RAM_FILES; slot ++ )
+  {
+    File & f = files[ slot ];
+    if( f.name[ 0 ] == 0 )
+    {
+      memset( & f, 0, sizeof( f ));
+      strcpy( f.name, name );
+      f.hash = hashOf( name );
+      f.first = NONE;
+      now( & f.date, & f.time );
+      index[ i ] = slot;
+      return slot;
+    }
+  }
+  return -1;
+}
+
+uint16_t FtpRamFs::allocBlock()
+{
+  uint16_t b = freeBlock;
+  if( b != NONE )
+  {
+    freeBlock = nextBlock[ b ];
+    nextBlock[ b ] = NONE;
+    nbFree --;
+  }
+  return b;
+}
+
+// Free the chain of blocks beginning with b
+
+void FtpRamFs::freeBlocks( uint16_t b )
+{
+  while( b != NONE )
+  {
+    uint16_t n = nextBlock[ b ];
+    nextBlock[ b ] = freeBlock;
+    freeBlock = b;
+    nbFree ++;
+    b = n;
+  }
+}
+
+void FtpRamFs::now( uint16_t * pdate, uint16_t * ptime )
+{
+  * pdate = FTP_RAM_DATE;
+  * ptime = 0;
+  if( dateTime != NULL )
+    dateTime( pdate, ptime );
+}
+
+/*******************************************************************************
+ **                              FILES IN RAM                                  **
+ *******************************************************************************/
+
+// Open path with oflag as SdFile::open(). With O_CREAT and without O_APPEND,
+//  the file ends where writing stops
+
+bool FtpRamFile::open( FtpRamFs * _fs, const char * path, int oflag )
+{
+  const char * n = FtpRamFs::name( path );
+  close();
+  if( n == NULL || ! _fs->mounted())
+    return false;
+  uint8_t i;
+  slot = _fs->lookup( n, & i );
+  writing = FtpFs::writeMode( oflag );
+  truncating = writing && ( oflag & O_CREAT ) == O_CREAT && ( oflag & O_APPEND ) != O_APPEND;
+  if( slot < 0 && writing && ( oflag & O_CREAT ) == O_CREAT )
+    slot = _fs->create( n );
+  if( slot < 0 )
+    return false;
+  FtpRamFs::File & f = _fs->files[ slot ];
+  if( f.writer || ( writing && f.readers > 0 ))
+    return false;
+  if( writing )
+    f.writer = true;
+  else
+    f.readers ++;
+  fs = _fs;
+  pos = 0;
+  block = FtpRamFs::NONE;
+  if( writing && ( oflag & O_APPEND ) == O_APPEND )
+    seekSet( f.size );
+  return true;
+}
+
+int FtpRamFile::read( void * b, size_t nb )
+{
+  FtpRamFs::File & f = fs->files[ slot ];
+  uint8_t * p = (uint8_t *) b;
+  if( nb > f.size - pos )
+    nb = f.size - pos;
+  size_t n = 0;
+  while( n < nb )
+  {
+    size_t o = pos % FTP_RAM_BLOCK;
+    if( o == 0 )
+      block = block == FtpRamFs::NONE ? f.first : fs->nextBlock[ block ];
+    size_t l = FTP_RAM_BLOCK - o < nb - n ? FTP_RAM_BLOCK - o : nb - n;
+    memcpy( p + n, fs->block( block ) + o, l );
+    n += l;
+    pos += l;
+  }
+  return n;
+}
+
+// Write nb bytes at pos, adding blocks as needed
+//
+//  return the number of bytes written, less than nb if the pool is full
+
+size_t FtpRamFile::write( const void * b, size_t nb )
+{
+  if( ! writing )
+    return 0;
+  FtpRamFs::File & f = fs->files[ slot ];
+  const uint8_t * p = (const uint8_t *) b;
+  size_t n = 0;
+  while( n < nb )
+  {
+    size_t o = pos % FTP_RAM_BLOCK;
+    if( o == 0 )
+    {
+      uint16_t nx = block == FtpRamFs::NONE ? f.first : fs->nextBlock[ block ];
+      if( nx == FtpRamFs::NONE )
+      {
+        nx = fs->allocBlock();
+        if( nx == FtpRamFs::NONE )
+          break;
+        if( block == FtpRamFs::NONE )
+          f.first = nx;
+        else
+          fs->nextBlock[ block ] = nx;
+      }
+      block = nx;
+    }
+    size_t l = FTP_RAM_BLOCK - o < nb - n ? FTP_RAM_BLOCK - o : nb - n;
+    memcpy( fs->block( block ) + o, p + n, l );
+    n += l;
+    pos += l;
+  }
+  if( pos > f.size )
+    f.size = pos;
+  return n;
+}
+
+bool FtpRamFile::seekSet( uint32_t _pos )
+{
+  FtpRamFs::File & f = fs->files[ slot ];
+  if( _pos > f.size )
+    return false;
+  pos = _pos;
+  block = FtpRamFs::NONE;
+  if( pos > 0 )
+  {
+    block = f.first;
+    for( uint32_t k = ( pos - 1 ) / FTP_RAM_BLOCK; k > 0; k -- )
+      block = fs->nextBlock[ block ];
+  }
+  return true;
+}
+
+void FtpRamFile::close()
+{
+  if( fs == NULL )
+    return;
+  FtpRamFs::File & f = fs->files[ slot ];
+  if( writing )
+  {
+    if( truncating && pos < f.size )
+    {
+      if( block == FtpRamFs::NONE )
+      {
+        fs->freeBlocks( f.first );
+        f.first = FtpRamFs::NONE;
+      }
+      else
+      {
+        fs->freeBlocks( fs->nextBlock[ block ]);
+        fs->nextBlock[ block ] = FtpRamFs::NONE;
+      }
+      f.size = pos;
+    }
+    fs->now( & f.date, & f.time );
+    f.writer = false;
+  }
+  else if( f.readers > 0 )
+    f.readers --;
+  fs = NULL;
+}
+
+#endif // FTP_RAM_FS_SIZE > 0
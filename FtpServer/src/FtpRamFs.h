@@ -0,0 +1,141 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                          FILE SYSTEM IN RAM                                **
+ **                                                                            **
+ *******************************************************************************/
+
+// Files whose path begins with FTP_RAM_MOUNT are kept in RAM, in a pool of
+//  FTP_RAM_FS_SIZE bytes allocated once by begin(). The directory is flat:
+//  it holds up to FTP_RAM_FILES files and no subdirectory.
+// The pool is divided in blocks of FTP_RAM_BLOCK bytes. The blocks of a file
+//  are chained by next[], and the free blocks too, so a block is allocated
+//  or freed in constant time.
+// Names are found through a hash table with linear probing, twice as large
+//  as the number of files, so a lookup reads one or two entries.
+// A file can be open by several readers or by one writer.
+
+#ifndef FTP_RAM_FS_H
+#define FTP_RAM_FS_H
+
+#if FTP_RAM_FS_SIZE > 0
+
+#define FTP_RAM_INDEX ( 2 * FTP_RAM_FILES ) // size of hash table of names
+
+#if FTP_RAM_FILES > 63
+  #error FTP_RAM_FILES must be at most 63
+#endif
+
+class FtpRamFs
+{
+public:
+  FtpRamFs() : pool( NULL ) {};
+
+  bool     begin();
+  bool     mounted() { return pool != NULL; };
+  static const char * name( const char * path );
+
+  bool     stat( const char * path, bool * pisDir, uint64_t * psize,
+                 uint16_t * pdate, uint16_t * ptime );
+  bool     remove( const char * path );
+  bool     rename( const char * path, const char * newpath );
+  bool     timeStamp( const char * path, uint16_t year, uint8_t month, uint8_t day,
+                      uint8_t hour, uint8_t minute, uint8_t second );
+  uint32_t capacity() { return (uint32_t) nbBlocks * FTP_RAM_BLOCK >> 10; };
+  uint32_t free() { return (uint32_t) nbFree * FTP_RAM_BLOCK >> 10; };
+
+  int8_t   next( int8_t slot );
+  const char * fileName( int8_t slot ) { return files[ slot ].name; };
+  uint32_t fileSize( int8_t slot ) { return files[ slot ].size; };
+  uint16_t fileDate( int8_t slot ) { return files[ slot ].date; };
+  uint16_t fileTime( int8_t slot ) { return files[ slot ].time; };
+
+  // Same as SdFile::dateTimeCallback(), for files written in RAM
+  static void dateTimeCallback( void ( * callback )( uint16_t * date, uint16_t * time ))
+                { dateTime = callback; };
+
+private:
+  friend class FtpRamFile;
+
+  enum { NONE = 0xffff };             // no block
+
+  struct File
+  {
+    char     name[ FTP_RAM_NAME ];    // empty if the entry is free
+    uint32_t hash,                    // hash of name
+             size;
+    uint16_t first,                   // first block, NONE if file is empty
+             date,
+             time;
+    uint8_t  readers;                 // opened to be read
+    bool     writer;                  // opened to be written
+  };
+
+  uint32_t hashOf( const char * name );
+  int8_t   lookup( const char * name, uint8_t * pi );
+  void     unindex( uint8_t i );
+  int8_t   create( const char * name );
+  uint16_t allocBlock();
+  void     freeBlocks( uint16_t b );
+  void     now( uint16_t * pdate, uint16_t * ptime );
+  uint8_t * block( uint16_t b ) { return pool + (uint32_t) b * FTP_RAM_BLOCK; };
+
+  static void ( * dateTime )( uint16_t * date, uint16_t * time );
+
+  uint8_t * pool;                     // blocks of files
+  uint16_t * nextBlock;               // next block of a file, or next free block
+  uint16_t nbBlocks,
+           nbFree,
+           freeBlock,                 // first free block
+           mountDate,                 // date and time of begin()
+           mountTime;
+  File     files[ FTP_RAM_FILES ];
+  int8_t   index[ FTP_RAM_INDEX ];    // files by hash of name, -1 if empty
+};
+
+// A file of FtpRamFs, with the methods of SdFile used by the sessions
+
+class FtpRamFile
+{
+public:
+  FtpRamFile() : fs( NULL ) {};
+
+  bool     open( FtpRamFs * _fs, const char * path, int oflag = O_READ );
+  bool     isOpen() { return fs != NULL; };
+  int      read( void * b, size_t nb );
+  size_t   write( const void * b, size_t nb );
+  bool     seekSet( uint32_t _pos );
+  uint32_t fileSize() { return fs->files[ slot ].size; };
+  void     close();
+
+private:
+  FtpRamFs * fs;                      // NULL if the file is closed
+  int8_t   slot;
+  uint32_t pos;                       // position in file
+  uint16_t block;                     // block holding byte pos - 1, NONE if pos is 0
+  bool     writing,
+           truncating;                // file ends at pos when closed
+};
+
+#endif // FTP_RAM_FS_SIZE > 0
+
+#endif // FTP_RAM_FS_H
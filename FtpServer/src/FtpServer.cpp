@@ -13,14 +13,15 @@
  * Commands implemented: 
  *   USER, PASS, AUTH (AUTH only return 'not implemented' code)
  *   CDUP, CWD, PWD, QUIT, NOOP
- *   MODE, PASV, PORT, STRU, TYPE
+ *   MODE (S and Z), PASV, PORT, STRU, TYPE
  *   ABOR, DELE, LIST, NLST, MLST, MLSD
- *   APPE, RETR, STOR
+ *   ALLO, APPE, REST, RETR, STOR
  *   MKD,  RMD
  *   RNTO, RNFR
  *   MDTM, MFMT
  *   FEAT, SIZE
- *   SITE FREE
+ *   HASH, RANG, OPTS (OPTS HASH only), XCRC, XMD5, XSHA1
+ *   SITE FREE, SITE RATE, SITE STATS
  *
  * Tested with those clients:
  *   under Windows:
@@ -63,11 +64,12 @@
 ArduinoOutStream FtpDebug( FTP_SERIAL );
 
 FtpServer::FtpServer( uint16_t _cmdPort, uint16_t _pasvPort )
-         : ftpServer( _cmdPort ), dataServer( _pasvPort ),
-           FtpOutCli( client ), FtpOutData( data )
+         : ftpServer( _cmdPort )
 {
   cmdPort = _cmdPort;
   pasvPort = _pasvPort;
+  iSession = 0;
+  rates( FTP_RATE_TRANSFER, FTP_RATE_TOTAL );
 }
 
 void FtpServer::init( IPAddress _localIP )
@@ -80,10 +82,12 @@ void FtpServer::init( IPAddress _localIP )
   localIp = _localIP == FTP_NULLIP() || (uint32_t) _localIP == 0 ? FTP_LOCALIP() : _localIP ;
   strcpy( user, FTP_USER ); 
   strcpy( pass, FTP_PASS ); 
-  dataServer.begin();
-  millisDelay = 0;
-  cmdStage = FTP_Stop;
-  iniVariables();
+  // Each session listen on its own data port in passive mode
+  for( uint8_t i = 0; i < FTP_MAX_SESSIONS; i ++ )
+    sessions[ i ].begin( this, pasvPort + i );
+  #if FTP_RAM_FS_SIZE > 0
+    ramFs.begin();
+  #endif
 }
 
 void FtpServer::credentials( const char * _user, const char * _pass )
@@ -94,22 +98,164 @@ void FtpServer::credentials( const char * _user, const char * _pass )
     strcpy( pass, _pass );
 }
 
-void FtpServer::iniVariables()
+uint8_t FtpServer::service()
+{
+  FtpSession * idle = NULL;
+  bool busy = true;
+  uint8_t i;
+
+  // search for a session waiting for a client
+  for( i = 0; i < FTP_MAX_SESSIONS && idle == NULL; i ++ )
+    if( sessions[ i ].cmdStage == FTP_Client )
+      idle = & sessions[ i ];
+    else if( sessions[ i ].cmdStage < FTP_Client ) // will soon be waiting
+      busy = false;
+
+  // a new client waits until a session is ready for it
+  //  or is refused if all sessions are serving a client
+  #ifdef ESP8266
+  if(( idle != NULL || busy ) && ftpServer.hasClient())
+  {
+    FTP_CLIENT newClient = ftpServer.available();
+  #else
+  FTP_CLIENT newClient;
+  if( idle != NULL || busy )
+    newClient = ftpServer.accept();
+  if( newClient )
+  {
+  #endif
+    if( idle != NULL )
+      idle->connect( newClient );
+    else                              // all sessions are busy
+    {
+      #ifdef FTP_DEBUG
+        FtpDebug << F(" Too many clients. Connection refused") << endl;
+      #endif
+      ArduinoOutStream out( newClient );
+      out << F("421 Too many users. Try again later") << endl;
+      newClient.stop();
+    }
+  }
+
+  // give a turn to each session, beginning after the last one served first
+  for( i = 0; i < FTP_MAX_SESSIONS; i ++ )
+  {
+    if( ++ iSession >= FTP_MAX_SESSIONS )
+      iSession = 0;
+    sessions[ iSession ].service();
+  }
+
+  // return the status of the most active session: one that transfers
+  //  data, else the one at the highest stage of command connexion
+  uint8_t most = 0;
+  for( i = 1; i < FTP_MAX_SESSIONS; i ++ )
+    if( sessions[ i ].activity() > sessions[ most ].activity())
+      most = i;
+  return sessions[ most ].status();
+}
+
+uint8_t FtpServer::status( uint8_t n )
+{
+  return n < FTP_MAX_SESSIONS ? sessions[ n ].status() : 0;
+}
+
+// Set the limits of bandwidth of each transfer (from the next one) and of
+//  all transfers, in bytes per second. 0 is no limit
+
+void FtpServer::rates( uint32_t transfer, uint32_t total )
+{
+  rateTransfer = transfer;
+  rateTotal.set( total );
+}
+
+// A file or directory was changed by the sketch: the listings and the
+//  files kept in cache for it are removed
+
+void FtpServer::fileChanged( const char * path )
+{
+  #if FTP_LIST_CACHE_SIZE > 0
+    listCache.invalidate( path );
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    fileCache.invalidate( path );
+  #endif
+}
+
+FtpSession::FtpSession()
+          : dataServer( FTP_DATA_PORT_PASV ),
+            bufPrint( buf, FTP_BUF_SIZE, nbBuf ), replyBuf( client ),
+            FtpOutCli( replyBuf ), FtpOutData( bufPrint )
+{
+  buf = NULL;
+  #ifdef FTP_RETR_PIPELINE
+    buf2 = NULL;
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    fileSlot = -1;
+  #endif
+}
+
+void FtpSession::begin( FtpServer * _server, uint16_t _pasvPort )
+{
+  server = _server;
+  replyBuf.setStats( & server->statistics );
+  pasvPort = _pasvPort;
+  dataServer = FTP_SERVER( pasvPort );
+  dataServer.begin();
+  millisDelay = 0;
+  cmdStage = FTP_Stop;
+  #if FTP_RAM_FS_SIZE > 0
+    mount.begin( cwdName, & server->ramFs );
+  #else
+    mount.begin( cwdName );
+  #endif
+  iniVariables();
+}
+
+void FtpSession::iniVariables()
 {
   // Default for data port
   dataPort = FTP_DATA_PORT_DFLT;
   
   // Default Data connection is Active
   dataConn = FTP_NoConn;
+  modeZ = false;
   
   // Set the root directory
   strcpy( cwdName, "/" );
+  mount.openCwd();
 
   rnfrCmd = false;
+  allocSize = 0;
+  preAllocated = false;
+  restartPos = 0;
+  hashAlg = FtpHash::SHA1;
+  rangeStart = 0;
+  rangeEnd = 0;
+  #if FTP_LIST_CACHE_SIZE > 0
+    cacheSlot = -1;
+    cacheSend = false;
+    storeDirHash = 0;
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    storeFileHash = 0;
+  #endif
   transferStage = FTP_Close;
 }
 
-uint8_t FtpServer::service()
+// Give to this session the client accepted by the server
+
+void FtpSession::connect( FTP_CLIENT & newClient )
+{
+  if( client )
+    client.stop();
+  client = newClient;
+  clientConnected();
+  millisEndConnection = millis() + 1000L * FTP_AUTH_TIME_OUT; // wait client id for 10 s.
+  cmdStage = FTP_User;
+}
+
+uint8_t FtpSession::service()
 {
   #ifdef FTP_DEBUG1
     int8_t data0 = data.status();
@@ -131,31 +277,15 @@ uint8_t FtpServer::service()
 		  abortTransfer();
 		  iniVariables();
 		  #ifdef FTP_DEBUG
-		    FtpDebug << F(" Ftp server waiting for connection on port ") << cmdPort << endl;
+		    FtpDebug << F(" Ftp server waiting for connection on port ") << server->cmdPort << endl;
 		  #endif
 		  cmdStage = FTP_Client;
 		}
-		else if( cmdStage == FTP_Client )     // Ftp server idle
-		{
-		  #ifdef ESP8266
-		  if( ftpServer.hasClient())
-		  {
-		    client.stop();
-		    client = ftpServer.available();
-		  }
-		  #else
-      if( client && ! client.connected())
-        client.stop();
-		  client = ftpServer.accept();
-		  #endif
-		  if( client.connected())             // A client connected
-		  {
-		    clientConnected();
-		    millisEndConnection = millis() + 1000L * FTP_AUTH_TIME_OUT; // wait client id for 10 s.
-		    cmdStage = FTP_User;
-		  }
-		}
-		else if( readChar() > 0 )             // got response
+		else if( cmdStage == FTP_Client )     // Session idle. FtpServer::service() will give it a client
+		  ;
+		else if( transferStage == FTP_Hash )  // Next commands wait for the reply to HASH
+		  ;
+		else if( readLine() > 0 )             // got response
 		{
 		  processCommand();
 		  if( cmdStage == FTP_Stop )
@@ -168,26 +298,14 @@ uint8_t FtpServer::service()
 		else if( ! client.connected() )
 		  cmdStage = FTP_Init;
 
-		if( transferStage == FTP_Retrieve )   // Retrieve data
+		if( transferStage != FTP_Close )      // Transfer data until budget is spent
 		{
-		  if( ! doRetrieve())
-		    transferStage = FTP_Close;
-		}
-		else if( transferStage == FTP_Store ) // Store data
-		{
-		  if( ! doStore())
-		    transferStage = FTP_Close;
-		}
-		else if( transferStage == FTP_List ||
-		         transferStage == FTP_Nlst)   // LIST or NLST
-		{
-		  if( ! doList())
-		    transferStage = FTP_Close;
-		}
-		else if( transferStage == FTP_Mlsd )  // MLSD listing
-		{
-		  if( ! doMlsd())
-		    transferStage = FTP_Close;
+		  uint32_t millisEndBudget = millis() + FTP_SERVICE_MS;
+		  uint32_t bytesEndBudget = bytesTransfered + FTP_SERVICE_BYTES;
+		  while( doTransfer() && ! transferWouldBlock() &&
+		         (int32_t) ( millisEndBudget - millis() ) > 0 &&
+		         (int32_t) ( bytesEndBudget - bytesTransfered ) > 0 )
+		    ;
 		}
 		else if( cmdStage > FTP_Client &&
 		         ! ((int32_t) ( millisEndConnection - millis() ) > 0 ))
@@ -206,11 +324,81 @@ uint8_t FtpServer::service()
 		             << F("  Data: ") << dataConn << endl
 		             << F("  Data socket: ") << hex << int( dstat ) << dec << endl;
 		#endif
+		replyBuf.send();                      // replies to transfers or timeout
+  }
+  return status();
+}
+
+// Move one chunk of data (or one directory entry)
+//
+//  return false when transfer is terminated
+
+bool FtpSession::doTransfer()
+{
+  bool more = false;
+  if( transferStage == FTP_Connect )    // Wait for data connection
+    more = doConnect();
+  else if( transferStage == FTP_Retrieve ) // Retrieve data
+    more = doRetrieve();
+  else if( transferStage == FTP_Store ) // Store data
+    more = doStore();
+  #if FTP_LIST_CACHE_SIZE > 0
+  else if( cacheSend )                  // listing from cache
+    more = doListCache();
+  #endif
+  else if( transferStage == FTP_List ||
+           transferStage == FTP_Nlst )  // LIST or NLST
+    more = doList();
+  else if( transferStage == FTP_Mlsd )  // MLSD listing
+    more = doMlsd();
+  else if( transferStage == FTP_Hash )  // HASH, XCRC, XMD5 or XSHA1
+    more = doHash();
+  if( ! more )
+  {
+    listCacheEnd( false );
+    endModeZ( false );
+    freeBuf();
+    transferStage = FTP_Close;
+  }
+  return more;
+}
+
+// Return true if next chunk of data would have to wait for the data connection
+
+bool FtpSession::transferWouldBlock()
+{
+  if( transferStage == FTP_Connect )
+    return ! data.connected();
+  if( transferStage == FTP_Retrieve )
+    return data.availableForWrite() == 0 || rateAvailable() == 0;
+  if( transferStage == FTP_Store )
+  {
+    #ifdef FTP_MODE_Z
+      if( unzip.pending())              // compressed data is waiting
+        return false;
+    #endif
+    return data.available() == 0 || rateAvailable() == 0;
   }
-  return cmdStage | ( transferStage << 3 ) | ( dataConn << 6 );
+  return false;
+}
+
+// Return the number of bytes that the limits of bandwidth allow to move now,
+//  by multiples of 512 so that files are read by whole sectors
+
+uint32_t FtpSession::rateAvailable()
+{
+  uint32_t na = rate.available();
+  uint32_t nt = server->rateTotal.available();
+  return ( na < nt ? na : nt ) & ~ 511UL;
+}
+
+void FtpSession::rateConsume( uint32_t nb )
+{
+  rate.consume( nb );
+  server->rateTotal.consume( nb );
 }
 
-void FtpServer::clientConnected()
+void FtpSession::clientConnected()
 {
   #ifdef FTP_DEBUG
     FtpDebug << F(" Client connected!") << endl;
@@ -218,767 +406,1598 @@ void FtpServer::clientConnected()
   FtpOutCli << F("220--- Welcome to FTP for Arduino ---") << endl;
   FtpOutCli << F("220---   By Jean-Michel Gallego   ---") << endl;
   FtpOutCli << F("220 --    Version ") << FTP_SERVER_VERSION << F("    --") << endl;
+  replyBuf.send();
   iCL = 0;
+  nextCL = 0;
+  dropCL = false;
 }
 
-void FtpServer::disconnectClient()
+void FtpSession::disconnectClient()
 {
   #ifdef FTP_DEBUG
     FtpDebug << F(" Disconnecting client") << endl;
   #endif
   abortTransfer();
   FtpOutCli << F("221 Goodbye") << endl;
+  replyBuf.send();
   if( client )
     client.stop();
   if( data )
     data.stop();
 }
 
-bool FtpServer::processCommand()
-{
-  ///////////////////////////////////////
-  //                                   //
-  //      AUTHENTICATION COMMANDS      //
-  //                                   //
-  ///////////////////////////////////////
+// Execute the command received from client
+//
+//  The command is found by its key, computed by readLine()
+//  The reply is sent by one write when the command is done
 
-  //
-  //  USER - User Identity 
-  //
-  if( CommandIs( "USER" ))
+bool FtpSession::processCommand()
+{
+  uint32_t t0 = server->statistics.clock();
+  st.valid = false;
+  // Only USER, PASS, FEAT and AUTH are allowed at stage of authentication
+  if( cmdStage < FTP_Cmd && cmdKey != ftpKey( "USER" ) && cmdKey != ftpKey( "PASS" ) &&
+      cmdKey != ftpKey( "FEAT" ) && cmdKey != ftpKey( "AUTH" ))
   {
-    if( ! strcmp( parameter, user ))
-    {
-      FtpOutCli << F("331 Ok. Password required") << endl;
-      strcpy( cwdName, "/" );
-      cmdStage = FTP_Pass;
-    }
-    else
-    {
-      FtpOutCli << F("530 ") << endl;
-      cmdStage = FTP_Stop;
-    }
+    FtpOutCli << F("530 ") << endl;
+    cmdStage = FTP_Stop;
+    replyBuf.send();
+    return true;
   }
-  //
-  //  PASS - Password
-  //
-  else if( CommandIs( "PASS" ))
+  switch( cmdKey )
   {
-    if( cmdStage != FTP_Pass )
-    {
-      FtpOutCli << F("503 ") << endl;
-      cmdStage = FTP_Stop;
-    }
-    if( ! strcmp( parameter, pass ))
-    {
-      #ifdef FTP_DEBUG
-        FtpDebug << F(" Authentication Ok. Waiting for commands.") << endl;
-      #endif
-      FtpOutCli << F("230 Ok") << endl;
-      cmdStage = FTP_Cmd;
-    }
-    else
-    {
-      FtpOutCli << F("530 ") << endl;
-      cmdStage = FTP_Stop;
-    }
+    // Authentication commands
+    case ftpKey( "USER" ): cmdUser(); break;
+    case ftpKey( "PASS" ): cmdPass(); break;
+    case ftpKey( "FEAT" ): cmdFeat(); break;
+    case ftpKey( "AUTH" ): cmdAuth(); break;
+    // Access control commands
+    case ftpKey( "PWD" ):  cmdPwd();  break;
+    case ftpKey( "CDUP" ): cmdCdup(); break;
+    case ftpKey( "CWD" ):  cmdCwd();  break;
+    case ftpKey( "QUIT" ): cmdQuit(); break;
+    // Transfer parameter commands
+    case ftpKey( "MODE" ): cmdMode(); break;
+    case ftpKey( "PASV" ): cmdPasv(); break;
+    case ftpKey( "PORT" ): cmdPort(); break;
+    case ftpKey( "STRU" ): cmdStru(); break;
+    case ftpKey( "TYPE" ): cmdType(); break;
+    // Ftp service commands
+    case ftpKey( "ABOR" ): cmdAbor(); break;
+    case ftpKey( "DELE" ): cmdDele(); break;
+    case ftpKey( "LIST" ):
+    case ftpKey( "NLST" ):
+    case ftpKey( "MLSD" ): cmdList(); break;
+    case ftpKey( "MLST" ): cmdMlst(); break;
+    case ftpKey( "NOOP" ): cmdNoop(); break;
+    case ftpKey( "RETR" ): cmdRetr(); break;
+    case ftpKey( "REST" ): cmdRest(); break;
+    case ftpKey( "ALLO" ): cmdAllo(); break;
+    case ftpKey( "STOR" ):
+    case ftpKey( "APPE" ): cmdStor(); break;
+    case ftpKey( "MKD" ):  cmdMkd();  break;
+    case ftpKey( "RMD" ):  cmdRmd();  break;
+    case ftpKey( "RNFR" ): cmdRnfr(); break;
+    case ftpKey( "RNTO" ): cmdRnto(); break;
+    // case ftpKey( "SYST" ): FtpOutCli << F("215 MSDOS") << endl; break;
+    // Extensions commands (RFC 3659)
+    case ftpKey( "MDTM" ):
+    case ftpKey( "MFMT" ): cmdMdtm(); break;
+    case ftpKey( "SIZE" ): cmdSize(); break;
+    case ftpKey( "SITE" ): cmdSite(); break;
+    case ftpKey( "OPTS" ): cmdOpts(); break;
+    // Checksums of files
+    case ftpKey( "RANG" ): cmdRang(); break;
+    case ftpKey( "HASH" ): cmdHash(); break;
+    case ftpKey( "XCRC" ):
+    case ftpKey( "XMD5" ):
+    case ftpKey( "XSHA1" ): cmdXcrc(); break;
+    // Unrecognized commands ...
+    default:
+      FtpOutCli << F("500 Unknow command") << endl;
+      cmdKey = 0;                       // counted with the other commands
   }
-  //
-  //  FEAT - New Features
-  //
-  else if( CommandIs( "FEAT" ))
-  {
-    FtpOutCli << F("211-Extensions suported:") << endl;
-    FtpOutCli << F(" MLST type*;modify*;size*;") << endl;
-    FtpOutCli << F(" MLSD") << endl;
-    FtpOutCli << F(" MDTM") << endl;
-    FtpOutCli << F(" MFMT") << endl;
-    FtpOutCli << F(" SIZE") << endl;
-    FtpOutCli << F(" SITE FREE") << endl;
-    FtpOutCli << F("211 End.") << endl;
+  server->statistics.command( cmdKey, t0 );
+  replyBuf.send();
+  return true;
+}
+
+///////////////////////////////////////
+//                                   //
+//      AUTHENTICATION COMMANDS      //
+//                                   //
+///////////////////////////////////////
+
+//
+//  USER - User Identity 
+//
+void FtpSession::cmdUser()
+{
+  if( ! strcmp( parameter, server->user ))
+  {
+    FtpOutCli << F("331 Ok. Password required") << endl;
+    strcpy( cwdName, "/" );
+    mount.openCwd();
+    cmdStage = FTP_Pass;
   }
-  //
-  //  AUTH - Not implemented
-  //
-  else if( CommandIs( "AUTH" ))
-    FtpOutCli << F("502 ") << endl;
-  //
-  //  Unrecognized commands at stage of authentication
-  //
-  else if( cmdStage < FTP_Cmd )
+  else
   {
     FtpOutCli << F("530 ") << endl;
     cmdStage = FTP_Stop;
   }
+}
 
-  ///////////////////////////////////////
-  //                                   //
-  //      ACCESS CONTROL COMMANDS      //
-  //                                   //
-  ///////////////////////////////////////
-
-  //
-  //  PWD - Print Directory
-  //
-  else if( CommandIs( "PWD" ) ||
-           ( CommandIs( "CWD" ) && ParameterIs( "." )))
-    FtpOutCli << F("257 \"") << cwdName << F("\"") << F(" is your current directory") << endl;
-  //
-  //  CDUP - Change to Parent Directory 
-  //
-  else if( CommandIs( "CDUP" ) ||
-           ( CommandIs( "CWD" ) && ParameterIs( ".." )))
-  {
-    bool ok = false;
-    
-    if( strlen( cwdName ) > 1 )            // do nothing if cwdName is root
-    {
-      // if cwdName ends with '/', remove it (must not append)
-      if( cwdName[ strlen( cwdName ) - 1 ] == '/' )
-        cwdName[ strlen( cwdName ) - 1 ] = 0;
-      // search last '/'
-      char * pSep = strrchr( cwdName, '/' );
-      ok = pSep > cwdName;
-      // if found, ends the string on its position
-      if( ok )
-      {
-        * pSep = 0;
-        ok = exists( cwdName );
-      }
-    }
-    // if an error appends, move to root
-    if( ! ok )
-      strcpy( cwdName, "/" );
-    FtpOutCli << F("250 Ok. Current directory is ") << cwdName << endl;
+//
+//  PASS - Password
+//
+void FtpSession::cmdPass()
+{
+  if( cmdStage != FTP_Pass )
+  {
+    FtpOutCli << F("503 ") << endl;
+    cmdStage = FTP_Stop;
   }
-  //
-  //  CWD - Change Working Directory
-  //
-  else if( CommandIs( "CWD" ))
+  if( ! strcmp( parameter, server->pass ))
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makeExistsPath( path ))
-    {
-      strcpy( cwdName, path );
-      FtpOutCli << F("250 Directory changed to ") << cwdName << endl;
-    }
+    #ifdef FTP_DEBUG
+      FtpDebug << F(" Authentication Ok. Waiting for commands.") << endl;
+    #endif
+    FtpOutCli << F("230 Ok") << endl;
+    cmdStage = FTP_Cmd;
   }
-  //
-  //  QUIT
-  //
-  else if( CommandIs( "QUIT" ))
+  else
   {
-    FtpOutCli << F("221 Goodbye") << endl;
-    disconnectClient();
+    FtpOutCli << F("530 ") << endl;
     cmdStage = FTP_Stop;
   }
+}
 
-  ///////////////////////////////////////
-  //                                   //
-  //    TRANSFER PARAMETER COMMANDS    //
-  //                                   //
-  ///////////////////////////////////////
+//
+//  FEAT - New Features
+//
+void FtpSession::cmdFeat()
+{
+  FtpOutCli << F("211-Extensions suported:") << endl;
+  FtpOutCli << F(" MLST type*;modify*;size*;") << endl;
+  FtpOutCli << F(" MLSD") << endl;
+  FtpOutCli << F(" MDTM") << endl;
+  FtpOutCli << F(" MFMT") << endl;
+  FtpOutCli << F(" REST STREAM") << endl;
+  FtpOutCli << F(" SIZE") << endl;
+  FtpOutCli << F(" SITE FREE") << endl;
+  FtpOutCli << F(" SITE RATE") << endl;
+  #ifdef FTP_STATS
+    FtpOutCli << F(" SITE STATS") << endl;
+  #endif
+  #ifdef FTP_MODE_Z
+    FtpOutCli << F(" MODE Z") << endl;
+  #endif
+  FtpOutCli << F(" HASH ");
+  for( uint8_t alg = 0; alg < FtpHash::Count; alg ++ )
+    FtpOutCli << FtpHash::name( alg ) << ( alg == hashAlg ? "*" : "" )
+              << ( alg + 1 < FtpHash::Count ? ";" : "" );
+  FtpOutCli << endl;
+  FtpOutCli << F(" RANG STREAM") << endl;
+  FtpOutCli << F(" XCRC") << endl;
+  FtpOutCli << F(" XMD5") << endl;
+  FtpOutCli << F(" XSHA1") << endl;
+  FtpOutCli << F("211 End.") << endl;
+}
 
-  //
-  //  MODE - Transfer Mode 
-  //
-  else if( CommandIs( "MODE" ))
-  {
-    if( ParameterIs( "S" ))
-      FtpOutCli << F("200 S Ok") << endl;
-    else
-      FtpOutCli << F("504 Only S(tream) is suported") << endl;
-  }
-  //
-  //  PASV - Passive Connection management
-  //
-  else if( CommandIs( "PASV" ))
-  {
-    data.stop();
-    dataServer.begin();
-    if((((uint32_t) FTP_LOCALIP()) & ((uint32_t) Ethernet.subnetMask())) ==
-       (((uint32_t) client.remoteIP()) & ((uint32_t) Ethernet.subnetMask())))
-      dataIp = FTP_LOCALIP();
-    else
-      dataIp = localIp;
-    dataPort = pasvPort;
-    #ifdef FTP_DEBUG
-      FtpDebug << F(" Connection management set to passive") << endl;
-      FtpDebug << F(" Listening at ")
-					     << int( dataIp[0]) << F(".") << int( dataIp[1]) << F(".") 
-					     << int( dataIp[2]) << F(".") << int( dataIp[3])  
-               << F(":") << dataPort << endl;
-    #endif
-    FtpOutCli << F("227 Entering Passive Mode") << F(" (")
-              << int( dataIp[0]) << F(",") << int( dataIp[1]) << F(",") 
-              << int( dataIp[2]) << F(",") << int( dataIp[3]) << F(",") 
-              << ( dataPort >> 8 ) << F(",") << ( dataPort & 255 ) << F(")") << endl;
-    dataConn = FTP_Pasive;
-  }
-  //
-  //  PORT - Data Port
-  //
-  else if( CommandIs( "PORT" ))
+//
+//  AUTH - Not implemented
+//
+void FtpSession::cmdAuth()
+{
+  FtpOutCli << F("502 ") << endl;
+}
+
+
+///////////////////////////////////////
+//                                   //
+//      ACCESS CONTROL COMMANDS      //
+//                                   //
+///////////////////////////////////////
+
+//
+//  PWD - Print Directory
+//
+void FtpSession::cmdPwd()
+{
+  FtpOutCli << F("257 \"") << cwdName << F("\"") << F(" is your current directory") << endl;
+}
+
+//
+//  CDUP - Change to Parent Directory 
+//
+void FtpSession::cmdCdup()
+{
+  bool ok = false;
+  
+  if( strlen( cwdName ) > 1 )            // do nothing if cwdName is root
   {
-    data.stop();
-    // get IP of data client
-    dataIp[ 0 ] = atoi( parameter );
-    char * p = strchr( parameter, ',' );
-    for( uint8_t i = 1; i < 4; i ++ )
+    // if cwdName ends with '/', remove it (must not append)
+    if( cwdName[ strlen( cwdName ) - 1 ] == '/' )
+      cwdName[ strlen( cwdName ) - 1 ] = 0;
+    // search last '/'
+    char * pSep = strrchr( cwdName, '/' );
+    ok = pSep > cwdName;
+    // if found, ends the string on its position
+    if( ok )
     {
-      dataIp[ i ] = atoi( ++ p );
-      p = strchr( p, ',' );
+      * pSep = 0;
+      ok = statPath( cwdName );
     }
-    // get port of data client
-    dataPort = 256 * atoi( ++ p );
-    p = strchr( p, ',' );
-    dataPort += atoi( ++ p );
-    if( p == NULL )
-      FtpOutCli << F("501 Can't interpret parameters") << endl;
-    else
-    {
-      #ifdef FTP_DEBUG
-        FtpDebug << F(" Data IP set to ") << int( dataIp[0]) << F(".") << int( dataIp[1])
-                 << F(".") << int( dataIp[2]) << F(".") << int( dataIp[3]) << endl;
-        FtpDebug << F(" Data port set to ") << dataPort << endl;
-      #endif
-      FtpOutCli << F("200 PORT command successful") << endl;
-      dataConn = FTP_Active;
-    }
-  }
-  //
-  //  STRU - File Structure
-  //
-  else if( CommandIs( "STRU" ))
-  {
-    if( ParameterIs( "F" ))
-      FtpOutCli << F("200 F Ok") << endl;
-    // else if( ParameterIs( "R" ))
-    //  FtpOutCli << F("200 B Ok") << endl;
-    else
-      FtpOutCli << F("504 Only F(ile) is suported") << endl;
   }
-  //
-  //  TYPE - Data Type
-  //
-  else if( CommandIs( "TYPE" ))
+  // if an error appends, move to root
+  if( ! ok )
+    strcpy( cwdName, "/" );
+  mount.openCwd();
+  FtpOutCli << F("250 Ok. Current directory is ") << cwdName << endl;
+}
+
+//
+//  CWD - Change Working Directory
+//
+void FtpSession::cmdCwd()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( ParameterIs( "." ))
+    cmdPwd();
+  else if( ParameterIs( ".." ))
+    cmdCdup();
+  else if( haveParameter() && makeExistsPath( path ))
   {
-    if( ParameterIs( "A" ))
-      FtpOutCli << F("200 TYPE is now ASCII") << endl;
-    else if( ParameterIs( "I" ))
-      FtpOutCli << F("200 TYPE is now 8-bit binary") << endl;
-    else
-      FtpOutCli << F("504 Unknow TYPE") << endl;
+    strcpy( cwdName, path );
+    mount.openCwd();
+    FtpOutCli << F("250 Directory changed to ") << cwdName << endl;
   }
+}
 
-  ///////////////////////////////////////
-  //                                   //
-  //        FTP SERVICE COMMANDS       //
-  //                                   //
-  ///////////////////////////////////////
+//
+//  QUIT
+//
+void FtpSession::cmdQuit()
+{
+  FtpOutCli << F("221 Goodbye") << endl;
+  disconnectClient();
+  cmdStage = FTP_Stop;
+}
 
-  //
-  //  ABOR - Abort
-  //
-  else if( CommandIs( "ABOR" ))
-  {
-    abortTransfer();
-    FtpOutCli << F("226 Data connection closed") << endl;
-  }
-  //
-  //  DELE - Delete a File 
-  //
-  else if( CommandIs( "DELE" ))
+
+///////////////////////////////////////
+//                                   //
+//    TRANSFER PARAMETER COMMANDS    //
+//                                   //
+///////////////////////////////////////
+
+//
+//  MODE - Transfer Mode 
+//
+void FtpSession::cmdMode()
+{
+  if( ParameterIs( "S" ))
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makeExistsPath( path ))
-      if( remove( path ))
-        FtpOutCli << F("250 Deleted ") << parameter << endl;
-      else
-        FtpOutCli << F("450 Can't delete ") << parameter << endl;
+    modeZ = false;
+    FtpOutCli << F("200 S Ok") << endl;
   }
-  //
-  //  LIST - List
-  //  NLST - Name List
-  //  MLSD - Listing for Machine Processing (see RFC 3659)
-  //
-  else if( CommandIs( "LIST" ) || CommandIs( "NLST" ) || CommandIs( "MLSD" ))
+  #ifdef FTP_MODE_Z
+  else if( ParameterIs( "Z" ))
   {
-    if( dataConnect())
-      if( openDir( & dir ))
-      {
-        nbMatch = 0;
-        if( CommandIs( "LIST" ))
-          transferStage = FTP_List;
-        else if( CommandIs( "NLST" ))
-          transferStage = FTP_Nlst;
-        else
-          transferStage = FTP_Mlsd;
-      }
-      else
-        data.stop();
+    modeZ = true;
+    FtpOutCli << F("200 Z Ok") << endl;
   }
-  //
-  //  MLST - Listing for Machine Processing (see RFC 3659)
-  //
-  else if( CommandIs( "MLST" ))
+  #endif
+  else
+    FtpOutCli << F("504 Mode not suported") << endl;
+}
+
+//
+//  PASV - Passive Connection management
+//
+void FtpSession::cmdPasv()
+{
+  data.stop();
+  dataServer.begin();
+  if((((uint32_t) FTP_LOCALIP()) & ((uint32_t) FTP_SUBNETMASK())) ==
+     (((uint32_t) client.remoteIP()) & ((uint32_t) FTP_SUBNETMASK())))
+    dataIp = FTP_LOCALIP();
+  else
+    dataIp = server->localIp;
+  dataPort = pasvPort;
+  #ifdef FTP_DEBUG
+    FtpDebug << F(" Connection management set to passive") << endl;
+    FtpDebug << F(" Listening at ")
+					     << int( dataIp[0]) << F(".") << int( dataIp[1]) << F(".") 
+					     << int( dataIp[2]) << F(".") << int( dataIp[3])  
+             << F(":") << dataPort << endl;
+  #endif
+  FtpOutCli << F("227 Entering Passive Mode") << F(" (")
+            << int( dataIp[0]) << F(",") << int( dataIp[1]) << F(",") 
+            << int( dataIp[2]) << F(",") << int( dataIp[3]) << F(",") 
+            << ( dataPort >> 8 ) << F(",") << ( dataPort & 255 ) << F(")") << endl;
+  dataConn = FTP_Pasive;
+}
+
+//
+//  PORT - Data Port
+//
+void FtpSession::cmdPort()
+{
+  data.stop();
+  // get IP of data client
+  dataIp[ 0 ] = atoi( parameter );
+  char * p = strchr( parameter, ',' );
+  for( uint8_t i = 1; i < 4; i ++ )
   {
-    char path[ FTP_CWD_SIZE ];
-    uint16_t dat, tim;
-    char dtStr[ 15 ];
-    bool isdir;
-    if( haveParameter() && makeExistsPath( path ))
-      if( ! getFileModTime( path, & dat, & tim ))
-        FtpOutCli << F("550 Unable to retrieve time for ") << parameter << endl;
-      else
-      {
-        isdir = isDir( path );
-        FtpOutCli << F("250-Begin") << endl
-                  << F(" Type=") << ( isdir ? F("dir") : F("file"))
-                  << F(";Modify=") << makeDateTimeStr( dtStr, dat, tim );
-        if( ! isdir )
-        {
-          if( file.open( path, O_READ ))
-          {
-            FtpOutCli << F(";Size=") << long( file.fileSize());
-            file.close();
-          }
-        }
-        FtpOutCli << F("; ") << path << endl
-                  << F("250 End.") << endl;
-      }
+    dataIp[ i ] = atoi( ++ p );
+    p = strchr( p, ',' );
   }
-  //
-  //  NOOP
-  //
-  else if( CommandIs( "NOOP" ))
-    FtpOutCli << F("200 Zzz...") << endl;
-  //
-  //  RETR - Retrieve
-  //
-  else if( CommandIs( "RETR" ))
+  // get port of data client
+  dataPort = 256 * atoi( ++ p );
+  p = strchr( p, ',' );
+  dataPort += atoi( ++ p );
+  if( p == NULL )
+    FtpOutCli << F("501 Can't interpret parameters") << endl;
+  else
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makeExistsPath( path ))
-      if( ! file.open( path, O_READ ))
-        FtpOutCli << F("450 Can't open ") << parameter << endl;
-      else if( dataConnect( false ))
-      {
-        #ifdef FTP_DEBUG
-          FtpDebug << F(" Sending ") << parameter << endl;
-        #endif
-        FtpOutCli << F("150-Connected to port ") << dataPort << endl;
-        FtpOutCli << F("150 ") << long( file.fileSize()) << F(" bytes to download") << endl;
-        millisBeginTrans = millis();
-        bytesTransfered = 0;
-        transferStage = FTP_Retrieve;
-      }
+    #ifdef FTP_DEBUG
+      FtpDebug << F(" Data IP set to ") << int( dataIp[0]) << F(".") << int( dataIp[1])
+               << F(".") << int( dataIp[2]) << F(".") << int( dataIp[3]) << endl;
+      FtpDebug << F(" Data port set to ") << dataPort << endl;
+    #endif
+    FtpOutCli << F("200 PORT command successful") << endl;
+    dataConn = FTP_Active;
   }
-  //
-  //  STOR - Store
-  //  APPE - Append
-  //
-  else if( CommandIs( "STOR" ) || CommandIs( "APPE" ))
-  {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makePath( path ))
-    {
-      bool open;
-      if( exists( path ))
-        open = file.open( path, O_WRITE | ( CommandIs( "APPE" ) ? O_APPEND : O_CREAT ));
-      else
-        open = file.open( path, O_WRITE | O_CREAT );
-      if( ! open )
-        FtpOutCli << F("451 Can't open/create ") << parameter << endl;
-      else if( ! dataConnect())
-        file.close();
-      else
-      {
-        #ifdef FTP_DEBUG
-          FtpDebug << F(" Receiving ") << parameter << endl;
-        #endif
-        millisBeginTrans = millis();
-        bytesTransfered = 0;
-        transferStage = FTP_Store;
-      }
+}
+
+//
+//  STRU - File Structure
+//
+void FtpSession::cmdStru()
+{
+  if( ParameterIs( "F" ))
+    FtpOutCli << F("200 F Ok") << endl;
+  // else if( ParameterIs( "R" ))
+  //  FtpOutCli << F("200 B Ok") << endl;
+  else
+    FtpOutCli << F("504 Only F(ile) is suported") << endl;
+}
+
+//
+//  TYPE - Data Type
+//
+void FtpSession::cmdType()
+{
+  if( ParameterIs( "A" ))
+    FtpOutCli << F("200 TYPE is now ASCII") << endl;
+  else if( ParameterIs( "I" ))
+    FtpOutCli << F("200 TYPE is now 8-bit binary") << endl;
+  else
+    FtpOutCli << F("504 Unknow TYPE") << endl;
+}
+
+
+///////////////////////////////////////
+//                                   //
+//        FTP SERVICE COMMANDS       //
+//                                   //
+///////////////////////////////////////
+
+//
+//  ABOR - Abort
+//
+void FtpSession::cmdAbor()
+{
+  abortTransfer();
+  FtpOutCli << F("226 Data connection closed") << endl;
+}
+
+//
+//  DELE - Delete a File 
+//
+void FtpSession::cmdDele()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( haveParameter() && makeExistsPath( path ))
+  {
+    if( mount.remove( path ))
+    {
+      listChanged( path );
+      FtpOutCli << F("250 Deleted ") << parameter << endl;
     }
+    else
+      FtpOutCli << F("450 Can't delete ") << parameter << endl;
   }
-  //
-  //  MKD - Make Directory
-  //
-  else if( CommandIs( "MKD" ))
+}
+
+//
+//  LIST - List
+//  NLST - Name List
+//  MLSD - Listing for Machine Processing (see RFC 3659)
+//
+void FtpSession::cmdList()
+{
+  if( ! openDir())
+    data.stop();
+  else
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makePath( path ))
+    ftpTransfer stage = cmdKey == ftpKey( "LIST" ) ? FTP_List :
+                        cmdKey == ftpKey( "NLST" ) ? FTP_Nlst : FTP_Mlsd;
+    if( dataConnect( stage ))
     {
-      if( exists( path ))
-        FtpOutCli << F("521 \"") << parameter << F("\" directory already exists") << endl;
+      nbMatch = 0;
+      nbBuf = 0;
+      listCacheBegin( stage );
+    }
+    else
+      mount.closeDir();
+  }
+}
+
+//
+//  MLST - Listing for Machine Processing (see RFC 3659)
+//
+void FtpSession::cmdMlst()
+{
+  char path[ FTP_CWD_SIZE ];
+  char dtStr[ 15 ];
+  char sizeStr[ 21 ];
+  if( haveParameter() && makeExistsPath( path ))
+  {
+    if( st.date == 0 )
+      FtpOutCli << F("550 Unable to retrieve time for ") << parameter << endl;
+    else
+    {
+      FtpOutCli << F("250-Begin") << endl
+                << F(" Type=") << ( st.isDir ? F("dir") : F("file"))
+                << F(";Modify=") << makeDateTimeStr( dtStr, st.date, st.time );
+      if( ! st.isDir )
+        FtpOutCli << F(";Size=") << makeSizeStr( sizeStr, st.size );
+      FtpOutCli << F("; ") << path << endl
+                << F("250 End.") << endl;
+    }
+  }
+}
+
+//
+//  NOOP
+//
+void FtpSession::cmdNoop()
+{
+  FtpOutCli << F("200 Zzz...") << endl;
+}
+
+//
+//  RETR - Retrieve
+//
+void FtpSession::cmdRetr()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( haveParameter() && makePath( path ))
+  {
+    if( ! openFile( path, O_READ ))     // path is read only if file can't be opened
+    {
+      if( statPath( path ))
+        FtpOutCli << F("450 Can't open ") << parameter << endl;
+      else
+        FtpOutCli << F("550 ") << path << F(" not found.") << endl;
+    }
+    else if( ! seekRestart())
+      closeFile();
+    else if( ! dataConnect( FTP_Retrieve, false ))
+      closeFile();
+    else
+    {
+      #ifdef FTP_DEBUG
+        FtpDebug << F(" Sending ") << parameter << endl;
+      #endif
+      FtpOutCli << F("150-Opening data connection to port ") << dataPort << endl;
+      char sizeStr[ 21 ];
+      FtpOutCli << F("150 ") << makeSizeStr( sizeStr, fileSize() - restartPos )
+                << F(" bytes to download") << endl;
+      #ifdef FTP_SENDFILE
+        zeroCopy = ! modeZ && ! inRam() && ! inCache();
+      #else
+        zeroCopy = false;
+      #endif
+      #ifdef FTP_RETR_PIPELINE
+        freeBuf2();
+        buf2 = modeZ || zeroCopy || inRam() || inCache()   // compressed download is not pipelined
+               ? NULL : newBuf();
+        bufSend = buf2;
+        nbSend = 0;
+        iSend = 0;
+        nbRead = 0;
+        eofRead = false;
+      #endif
+    }
+  }
+  restartPos = 0;
+}
+
+//
+//  REST - Restart
+//
+//  Next RETR or STOR begins at this position in file
+//
+void FtpSession::cmdRest()
+{
+  if( parameter == NULL || ! isdigit( * parameter ))
+    FtpOutCli << F("501 No restart position") << endl;
+  else
+  {
+    restartPos = strtoull( parameter, NULL, 10 );
+    FtpOutCli << F("350 Restart position accepted") << endl;
+  }
+}
+
+//
+//  ALLO - Allocate
+//
+//  The size is reserved with the next STOR, so the file is contiguous
+//
+void FtpSession::cmdAllo()
+{
+  #ifdef FTP_PREALLOCATE
+    if( parameter == NULL || ! isdigit( * parameter ))
+      FtpOutCli << F("501 No size") << endl;
+    else
+    {
+      uint64_t size = strtoull( parameter, NULL, 10 );
+      if( size > 0xffffffffUL )         // preAllocate() takes 32 bits
+        FtpOutCli << F("504 Can't allocate more than 4294967295 bytes") << endl;
       else
       {
-        #ifdef FTP_DEBUG
-          FtpDebug << F(" Creating directory ") << parameter << endl;
-        #endif
-        if( makeDir( path ))
-          FtpOutCli << F("257 \"") << parameter << F("\"") << F(" created") << endl;
-        else
-          FtpOutCli << F("550 Can't create \"") << parameter << F("\"") << endl;
+        allocSize = size;
+        FtpOutCli << F("200 ") << allocSize << F(" bytes will be allocated") << endl;
       }
     }
+  #else
+    FtpOutCli << F("202 ALLO not needed") << endl;
+  #endif
+}
+
+//
+//  STOR - Store
+//  APPE - Append
+//
+void FtpSession::cmdStor()
+{
+  char path[ FTP_CWD_SIZE ];
+  bool appe = cmdKey == ftpKey( "APPE" );
+  if( appe )
+    restartPos = 0;
+  if( haveParameter() && makePath( path ))
+  {
+    bool open;
+    if( restartPos > 0 )
+      open = openFile( path, O_WRITE );
+    else if( statPath( path ))
+      open = openFile( path, O_WRITE | ( appe ? O_APPEND : O_CREAT ));
+    else
+      open = openFile( path, O_WRITE | O_CREAT );
+    if( ! open )
+      FtpOutCli << F("451 Can't open/create ") << parameter << endl;
+    else if( ! seekRestart())
+      closeFile();
+    else if( ! dataConnect( FTP_Store ))
+      closeFile();
+    else
+    {
+      #ifdef FTP_DEBUG
+        FtpDebug << F(" Receiving ") << parameter << endl;
+      #endif
+      nbBuf = 0;
+      storeCrc = 0;
+      sectorOffset = ( appe ? fileSize() : restartPos ) % 512;
+      preAllocated = allocSize > 0 && mount.preAllocate( allocSize );
+      listChanged( path );
+      #if FTP_LIST_CACHE_SIZE > 0
+        storeDirHash = server->listCache.dirHash( path );
+      #endif
+      #if FTP_FILE_CACHE_SIZE > 0
+        storeFileHash = server->fileCache.hashOf( path );
+      #endif
+      #ifdef FTP_DEBUG
+        if( preAllocated )
+          FtpDebug << F(" Allocated ") << allocSize << F(" bytes") << endl;
+      #endif
+    }
   }
-  //
-  //  RMD - Remove a Directory 
-  //
-  else if( CommandIs( "RMD" ))
+  allocSize = 0;
+  restartPos = 0;
+}
+
+//
+//  MKD - Make Directory
+//
+void FtpSession::cmdMkd()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( haveParameter() && makePath( path ))
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makeExistsPath( path ))
-      if( removeDir( path ))
+    if( statPath( path ))
+      FtpOutCli << F("521 \"") << parameter << F("\" directory already exists") << endl;
+    else
+    {
+      #ifdef FTP_DEBUG
+        FtpDebug << F(" Creating directory ") << parameter << endl;
+      #endif
+      if( mount.makeDir( path ))
       {
-        #ifdef FTP_DEBUG
-          FtpDebug << F(" Deleting ") << path << endl;
-        #endif
-        FtpOutCli << F("250 \"") << parameter << F("\" deleted") << endl;
+        listChanged( path );
+        FtpOutCli << F("257 \"") << parameter << F("\"") << F(" created") << endl;
       }
       else
-        FtpOutCli << F("550 Can't remove \"") << parameter << F("\". Directory not empty?") << endl;
+        FtpOutCli << F("550 Can't create \"") << parameter << F("\"") << endl;
+    }
   }
-  //
-  //  RNFR - Rename From 
-  //
-  else if( CommandIs( "RNFR" ))
+}
+
+//
+//  RMD - Remove a Directory 
+//
+void FtpSession::cmdRmd()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( haveParameter() && makeExistsPath( path ))
   {
-    rnfrName[ 0 ] = 0;
-    if( haveParameter() && makeExistsPath( rnfrName ))
+    if( mount.removeDir( path ))
     {
+      listChanged( path );
       #ifdef FTP_DEBUG
-        FtpDebug << F(" Ready for renaming ") << rnfrName << endl;
+        FtpDebug << F(" Deleting ") << path << endl;
       #endif
-      FtpOutCli << F("350 RNFR accepted - file exists, ready for destination") << endl;
-      rnfrCmd = true;
+      FtpOutCli << F("250 \"") << parameter << F("\" deleted") << endl;
     }
+    else
+      FtpOutCli << F("550 Can't remove \"") << parameter << F("\". Directory not empty?") << endl;
   }
-  //
-  //  RNTO - Rename To 
-  //
-  else if( CommandIs( "RNTO" ))
+}
+
+//
+//  RNFR - Rename From 
+//
+void FtpSession::cmdRnfr()
+{
+  rnfrName[ 0 ] = 0;
+  if( haveParameter() && makeExistsPath( rnfrName ))
   {
-    char path[ FTP_CWD_SIZE ];
-    char dirp[ FTP_FIL_SIZE ];
-    if( strlen( rnfrName ) == 0 || ! rnfrCmd )
-      FtpOutCli << F("503 Need RNFR before RNTO") << endl;
-    else if( haveParameter() && makePath( path ))
+    #ifdef FTP_DEBUG
+      FtpDebug << F(" Ready for renaming ") << rnfrName << endl;
+    #endif
+    FtpOutCli << F("350 RNFR accepted - file exists, ready for destination") << endl;
+    rnfrCmd = true;
+  }
+}
+
+//
+//  RNTO - Rename To 
+//
+void FtpSession::cmdRnto()
+{
+  char path[ FTP_CWD_SIZE ];
+  char dirp[ FTP_CWD_SIZE ];
+  if( strlen( rnfrName ) == 0 || ! rnfrCmd )
+    FtpOutCli << F("503 Need RNFR before RNTO") << endl;
+  else if( haveParameter() && makePath( path ))
+  {
+    if( statPath( path ))
+      FtpOutCli << F("553 ") << parameter << F(" already exists") << endl;
+    else
     {
-      if( exists( path ))
-        FtpOutCli << F("553 ") << parameter << F(" already exists") << endl;
-      else
+      strcpy( dirp, path );
+      char * psep = strrchr( dirp, '/' );
+      bool fail = psep == NULL;
+      if( ! fail )
       {
-        strcpy( dirp, path );
-        char * psep = strrchr( dirp, '/' );
-        bool fail = psep == NULL;
-        if( ! fail )
+        if( psep == dirp )
+          psep ++;
+        * psep = 0;
+        fail = ! statPath( dirp ) || ! st.isDir;
+        if( fail )
+          FtpOutCli << F("550 \"") << dirp << F("\" is not directory") << endl;
+        else
         {
-          if( psep == dirp )
-            psep ++;
-          * psep = 0;
-          fail = ! isDir( dirp );
-          if( fail )
-            FtpOutCli << F("550 \"") << dirp << F("\" is not directory") << endl;
-          else
+          #ifdef FTP_DEBUG
+            FtpDebug << F(" Renaming ") << rnfrName << F(" to ") << path << endl;
+          #endif
+          if( mount.rename( rnfrName, path ))
           {
-            #ifdef FTP_DEBUG
-              FtpDebug << F(" Renaming ") << rnfrName << F(" to ") << path << endl;
-            #endif
-            if( rename( rnfrName, path ))
-              FtpOutCli << F("250 File successfully renamed or moved") << endl;
-            else
-              fail = true;
+            listChanged( rnfrName );
+            listChanged( path );
+            FtpOutCli << F("250 File successfully renamed or moved") << endl;
           }
+          else
+            fail = true;
         }
-        if( fail )
-          FtpOutCli << F("451 Rename/move failure") << endl;
       }
+      if( fail )
+        FtpOutCli << F("451 Rename/move failure") << endl;
     }
-    rnfrCmd = false;
-  }
-  /*
-  //
-  //  SYST - System
-  //
-  else if( CommandIs( "SYST" ))
-    FtpOutCli << F("215 MSDOS") << endl;
-  */
-  
-  ///////////////////////////////////////
-  //                                   //
-  //   EXTENSIONS COMMANDS (RFC 3659)  //
-  //                                   //
-  ///////////////////////////////////////
-
-  //
-  //  MDTM && MFMT - File Modification Time (see RFC 3659)
-  //
-  else if( CommandIs( "MDTM" ) || CommandIs( "MFMT" ))
-  {
-    if( haveParameter())
+  }
+  rnfrCmd = false;
+}
+
+
+///////////////////////////////////////
+//                                   //
+//   EXTENSIONS COMMANDS (RFC 3659)  //
+//                                   //
+///////////////////////////////////////
+
+//
+//  MDTM && MFMT - File Modification Time (see RFC 3659)
+//
+void FtpSession::cmdMdtm()
+{
+  if( haveParameter())
+  {
+    char path[ FTP_CWD_SIZE ];
+    char * fname = parameter;
+    uint16_t year;
+    uint8_t month, day, hour, minute, second, setTime;
+    char dt[ 15 ];
+    bool mdtm = cmdKey == ftpKey( "MDTM" );
+
+    setTime = getDateTime( dt, & year, & month, & day, & hour, & minute, & second );
+    // fname point to file name
+    fname += setTime;
+    if( strlen( fname ) <= 0 )
+      FtpOutCli << "501 No file name" << endl;
+    else if( makeExistsPath( path, fname ))
     {
-      char path[ FTP_CWD_SIZE ];
-      char * fname = parameter;
-      uint16_t year;
-      uint8_t month, day, hour, minute, second, setTime;
-      char dt[ 15 ];
-      bool mdtm = CommandIs( "MDTM" );
-
-      setTime = getDateTime( dt, & year, & month, & day, & hour, & minute, & second );
-      // fname point to file name
-      fname += setTime;
-      if( strlen( fname ) <= 0 )
-        FtpOutCli << "501 No file name" << endl;
-      else if( makeExistsPath( path, fname ))
-        if( setTime ) // set file modification time
-        {
-          if( timeStamp( path, year, month, day, hour, minute, second ))
-            FtpOutCli << "213 " << dt << endl;
-          else
-            FtpOutCli << "550 Unable to modify time" << endl;
-        }
-        else if( mdtm ) // get file modification time
+      if( setTime ) // set file modification time
+      {
+        if( mount.timeStamp( path, year, month, day, hour, minute, second ))
         {
-          uint16_t dat, tim;
-          char dtStr[ 15 ];
-          if( getFileModTime( path, & dat, & tim ))
-            FtpOutCli << "213 " << makeDateTimeStr( dtStr, dat, tim ) << endl;
-          else
-            FtpOutCli << "550 Unable to retrieve time" << endl;
+          listChanged( path );
+          FtpOutCli << "213 " << dt << endl;
         }
+        else
+          FtpOutCli << "550 Unable to modify time" << endl;
+      }
+      else if( mdtm ) // get file modification time
+      {
+        char dtStr[ 15 ];
+        if( st.date != 0 )
+          FtpOutCli << "213 " << makeDateTimeStr( dtStr, st.date, st.time ) << endl;
+        else
+          FtpOutCli << "550 Unable to retrieve time" << endl;
+      }
     }
   }
-  //
-  //  SIZE - Size of the file
-  //
-  else if( CommandIs( "SIZE" ))
+}
+
+//
+//  SIZE - Size of the file
+//
+void FtpSession::cmdSize()
+{
+  char path[ FTP_CWD_SIZE ];
+  char sizeStr[ 21 ];
+  if( haveParameter() && makeExistsPath( path ))
+    FtpOutCli << F("213 ") << makeSizeStr( sizeStr, st.size ) << endl;
+}
+
+//
+//  SITE - System command
+//
+void FtpSession::cmdSite()
+{
+  if( ParameterIs( "FREE" ))
   {
-    char path[ FTP_CWD_SIZE ];
-    if( haveParameter() && makeExistsPath( path ))
-      if( ! file.open( path ))
-        FtpOutCli << F("450 Can't open ") << parameter << endl;
-      else
+    uint32_t capa = mount.capacity( cwdName );
+    if(( capa >> 10 ) < 1000 ) // less than 1 Giga
+      FtpOutCli << F("200 ") << mount.free( cwdName ) << F(" kB free of ") 
+                << capa << F(" kB capacity") << endl;
+    else
+      FtpOutCli << F("200 ") << ( mount.free( cwdName ) >> 10 ) << F(" MB free of ") 
+                << ( capa >> 10 ) << F(" MB capacity") << endl;
+  }
+  #ifdef FTP_STATS
+  else if( ParameterIs( "STATS" ))
+  {
+    server->statistics.print( FtpOutCli, "211-" );
+    FtpOutCli << F("211 End.") << endl;
+  }
+  else if( ParameterIs( "STATS RESET" ))
+  {
+    server->clearStats();
+    FtpOutCli << F("200 Statistics cleared") << endl;
+  }
+  #endif
+  else if( parameter != NULL && ! strncmp( parameter, "RATE", 4 ) &&
+           ( parameter[ 4 ] == 0 || parameter[ 4 ] == ' ' ))
+  {
+    // SITE RATE [transfer [total]], in kbytes/s, that must fit in 32 bits in bytes/s
+    const uint32_t rateMax = 0xffffffffUL / 1000;
+    char * p = parameter + 4;
+    while( * p == ' ' )
+      p ++;
+    if( isdigit( * p ))
+    {
+      uint64_t transfer = strtoull( p, & p, 10 );
+      while( * p == ' ' )
+        p ++;
+      uint64_t total = isdigit( * p ) ? strtoull( p, NULL, 10 ) : 0;
+      if( transfer > rateMax || total > rateMax )
       {
-        FtpOutCli << F("213 ") << long( file.fileSize()) << endl;
-        file.close();
+        FtpOutCli << F("501 Rate limits are at most ") << rateMax << F(" kB/s") << endl;
+        return;
       }
+      server->rates( transfer * 1000, isdigit( * p ) ? total * 1000 : server->rateTotal.get());
+    }
+    FtpOutCli << F("200 Rate limits in kB/s (0 for none): ")
+              << server->rateTransfer / 1000 << F(" by transfer, ")
+              << server->rateTotal.get() / 1000 << F(" in total") << endl;
+  }
+  else
+    FtpOutCli << F("500 Unknow SITE command ") << parameter << endl;
+}
+
+//
+//  OPTS - Options
+//
+//  Only OPTS HASH is known: it gives, or selects, the algorithm of HASH
+//
+void FtpSession::cmdOpts()
+{
+  char * p = parameter;
+  if( p == NULL || strncasecmp( p, "HASH", 4 ) != 0 || ( p[ 4 ] != 0 && p[ 4 ] != ' ' ))
+  {
+    FtpOutCli << F("501 Unknown option") << endl;
+    return;
   }
-  //
-  //  SITE - System command
-  //
-  else if( CommandIs( "SITE" ))
+  for( p += 4; * p == ' '; p ++ )
+    ;
+  if( * p != 0 )
   {
-    if( ParameterIs( "FREE" ))
+    int8_t alg = FtpHash::find( p );
+    if( alg < 0 )
     {
-      uint32_t capa = capacity();
-      if(( capa >> 10 ) < 1000 ) // less than 1 Giga
-        FtpOutCli << F("200 ") << free() << F(" kB free of ") 
-                  << capa << F(" kB capacity") << endl;
-      else
-        FtpOutCli << F("200 ") << ( free() >> 10 ) << F(" MB free of ") 
-                  << ( capa >> 10 ) << F(" MB capacity") << endl;
+      FtpOutCli << F("501 Unknown algorithm ") << p << endl;
+      return;
     }
-    else
-      FtpOutCli << F("500 Unknow SITE command ") << parameter << endl;
+    hashAlg = alg;
+  }
+  FtpOutCli << F("200 ") << FtpHash::name( hashAlg ) << endl;
+}
+
+//
+//  RANG - Range of bytes of next HASH
+//
+//  Positions of first and last bytes. RANG 1 0 returns to the whole file
+//
+void FtpSession::cmdRang()
+{
+  char * p = parameter;
+  if( p == NULL || ! isdigit( * p ))
+  {
+    FtpOutCli << F("501 No range") << endl;
+    return;
   }
-  //
-  //  Unrecognized commands ...
-  //
+  uint64_t start = strtoull( p, & p, 10 );
+  while( * p == ' ' )
+    p ++;
+  if( ! isdigit( * p ))
+  {
+    FtpOutCli << F("501 No end of range") << endl;
+    return;
+  }
+  uint64_t end = strtoull( p, NULL, 10 );
+  if( start == 1 && end == 0 )
+  {
+    rangeStart = 0;
+    rangeEnd = 0;
+    FtpOutCli << F("350 Restarting at 0. Ending at end of file.") << endl;
+  }
+  else if( end < start )
+    FtpOutCli << F("501 End of range before its start") << endl;
   else
-    FtpOutCli << F("500 Unknow command") << endl;
+  {
+    rangeStart = start;
+    rangeEnd = end;
+    char startStr[ 21 ], endStr[ 21 ];
+    FtpOutCli << F("350 Restarting at ") << makeSizeStr( startStr, start )
+              << F(". Ending at ") << makeSizeStr( endStr, end ) << F(".") << endl;
+  }
+}
+
+//
+//  HASH - Digest of a file with the algorithm selected by OPTS HASH
+//
+void FtpSession::cmdHash()
+{
+  char path[ FTP_CWD_SIZE ];
+  if( haveParameter() && makeExistsPath( path ))
+  {
+    uint64_t end = rangeStart == 0 && rangeEnd == 0 ? st.size : rangeEnd + 1;
+    if( end > st.size )
+      end = st.size;
+    beginHash( path, hashAlg, rangeStart, end );
+  }
+  rangeStart = 0;
+  rangeEnd = 0;
+}
+
+//
+//  XCRC - CRC-32 of a file
+//  XMD5 - MD5 of a file
+//  XSHA1 - SHA-1 of a file
+//
+//  Parameters are the name of the file, between quotes if it has spaces,
+//   and optionally the start and end (excluded) positions in file
+//
+void FtpSession::cmdXcrc()
+{
+  char path[ FTP_CWD_SIZE ];
+  char * name = parameter;
+  char * p = NULL;
+  if( name != NULL && * name == '"' )
+  {
+    p = strchr( ++ name, '"' );
+    if( p != NULL )
+      * p ++ = 0;
+  }
+  if( haveParameter() && makeExistsPath( path, name ))
+  {
+    uint64_t start = 0, end = 0;
+    if( p != NULL )
+    {
+      start = strtoull( p, & p, 10 );
+      end = strtoull( p, NULL, 10 );
+    }
+    if( end == 0 || end > st.size )
+      end = st.size;
+    beginHash( path, cmdKey == ftpKey( "XCRC" ) ? FtpHash::CRC32 :
+                     cmdKey == ftpKey( "XMD5" ) ? FtpHash::MD5 : FtpHash::SHA1,
+               start, end );
+  }
+}
+
+// Prepare the data connection for a transfer of type stage
+//
+//  The connection is established by doConnect() during next calls to
+//  service(), so that the sketch is never blocked. Then the transfer begins
+//
+//  return false if there is no data connection (no PASV or PORT command)
+
+bool FtpSession::dataConnect( ftpTransfer stage, bool out150 )
+{
+  if( ! data.connected() && dataConn == FTP_NoConn )
+  {
+    FtpOutCli << F("425 No data connection") << endl;
+    return false;
+  }
+  if( ! takeBuf())
+    return false;
+  if( out150 )
+    FtpOutCli << F("150 Opening data connection to port ") << dataPort << endl;
+  connectStage = stage;
+  transferStage = FTP_Connect;
+  millisBeginTrans = millis();
   return true;
 }
 
-int FtpServer::dataConnect( bool out150 )
+// Accept the connection of the client in passive mode, or connect to
+//  the client in active mode
+//
+//  return false if connection failed
+
+bool FtpSession::doConnect()
 {
   if( ! data.connected())
+  {
     if( dataConn == FTP_Pasive )
     {
-      uint16_t count = 1000; // wait up to a second
-      while( ! data.connected() && count -- > 0 )
+      #ifdef ESP8266
+      if( dataServer.hasClient())
+      {
+        data.stop();
+        data = dataServer.available();
+      }
+      #else
+      data = dataServer.accept();
+      #endif
+    }
+    else if( dataConn == FTP_Active )
+      data.connect( dataIp, dataPort );
+  }
+  if( data.connected())
+  {
+    server->statistics.connect( millis() - millisBeginTrans );
+    rate.set( server->rateTransfer );
+    millisBeginTrans = millis();
+    bytesTransfered = 0;
+    transferStage = connectStage;
+    if( beginModeZ())
+      return true;
+    FtpOutCli << F("451 Not enough memory for MODE Z") << endl;
+  }
+  // wait up to a second for client in passive mode
+  else if( dataConn == FTP_Pasive && (int32_t) ( millis() - millisBeginTrans ) < 1000 )
+    return true;
+  else
+    FtpOutCli << F("425 No data connection") << endl;
+  closeFile();
+  mount.closeDir();
+  freeBuf2();
+  data.stop();
+  return false;
+}
+
+bool FtpSession::dataConnected()
+{
+  if( data.connected())
+    return true;
+  data.stop();
+  FtpOutCli << F("426 Data connection closed. Transfer aborted") << endl;
+  transferStage = FTP_Close;
+  return false;
+}
+ 
+bool FtpSession::openDir()
+{
+  bool openD = mount.openDir( cwdName );
+  if( ! openD )
+    FtpOutCli << F("550 Can't open directory ") << cwdName << endl;
+  return openD;
+}
+
+bool FtpSession::doRetrieve()
+{
+  if( ! dataConnected())
+  {
+    closeFile();
+    freeBuf2();
+    return false;
+  }
+  if( zeroCopy )
+  {
+    uint32_t ra = rateAvailable();
+    if( ra == 0 )                       // wait for the limit of bandwidth
+      return true;
+    long nb = sendFile( ra < FTP_SERVICE_BYTES ? ra : FTP_SERVICE_BYTES );
+    if( nb > 0 )
+    {
+      rateConsume( nb );
+      bytesTransfered += nb;
+      return true;
+    }
+    if( nb == 0 )
+    {
+      closeTransfer();
+      return false;
+    }
+    zeroCopy = false;                   // not possible: file is sent through buf
+  }
+  #ifdef FTP_RETR_PIPELINE
+    if( buf2 != NULL )
+      return doRetrievePipe();
+  #endif
+  uint32_t ra = rateAvailable();
+  if( ra == 0 )                         // wait for the limit of bandwidth
+    return true;
+  uint32_t t0 = server->statistics.clock();
+  int16_t nb = readFile( buf, ra < FTP_BUF_SIZE ? ra : FTP_BUF_SIZE );
+  server->statistics.read( t0 );
+  if( nb > 0 )
+  {
+    writeData( buf, nb );
+    rateConsume( nb );
+    bytesTransfered += nb;
+    return true;
+  }
+  closeTransfer();
+  return false;
+}
+
+// Pipelined download
+//  bufSend is written to the data connection, never more than the client can
+//  accept without waiting, while the other buffer is filled from the file.
+//  Buffers are swapped when all bytes of bufSend are sent
+
+bool FtpSession::doRetrievePipe()
+{
+  #ifdef FTP_RETR_PIPELINE
+    if( iSend >= nbSend && nbRead > 0 )
+    {
+      bufSend = bufSend == buf ? buf2 : buf;
+      nbSend = nbRead;
+      iSend = 0;
+      nbRead = 0;
+    }
+    if( iSend < nbSend )
+    {
+      int nb = data.availableForWrite();
+      if( nb > nbSend - iSend )
+        nb = nbSend - iSend;
+      uint32_t ra = rateAvailable();
+      if((uint32_t) nb > ra )
+        nb = ra;
+      if( nb > 0 )
+      {
+        nb = data.write( bufSend + iSend, nb );
+        iSend += nb;
+        rateConsume( nb );
+        bytesTransfered += nb;
+      }
+    }
+    if( nbRead == 0 && ! eofRead )
+    {
+      uint32_t t0 = server->statistics.clock();
+      int16_t nb = readFile( bufSend == buf ? buf2 : buf, FTP_BUF_SIZE );
+      server->statistics.read( t0 );
+      if( nb > 0 )
+        nbRead = nb;
+      else
+        eofRead = true;
+    }
+    if( ! eofRead || iSend < nbSend || nbRead > 0 )
+      return true;
+  #endif
+  closeTransfer();
+  return false;
+}
+
+// Move to the position given by REST, if any
+
+bool FtpSession::seekRestart()
+{
+  if( restartPos == 0 )
+    return true;
+  if( restartPos <= fileSize() && seekFile( restartPos ))
+    return true;
+  FtpOutCli << F("554 Can't restart at this position") << endl;
+  restartPos = 0;
+  return false;
+}
+
+// Return a buffer of the pool, or allocated if all are used
+
+uint8_t * FtpSession::newBuf()
+{
+  uint8_t * b = server->bufPool.take();
+  return b != NULL ? b : (uint8_t *) malloc( FTP_BUF_SIZE );
+}
+
+void FtpSession::deleteBuf( uint8_t * b )
+{
+  if( b != NULL && ! server->bufPool.give( b ))
+    ::free( b );
+}
+
+// Get the buffer of a transfer
+//
+//  return false if there is not enough memory
+
+bool FtpSession::takeBuf()
+{
+  if( buf == NULL )
+    buf = newBuf();
+  if( buf != NULL )
+    return true;
+  FtpOutCli << F("451 Not enough memory for transfer") << endl;
+  return false;
+}
+
+// Release the buffer at the end of a transfer
+
+void FtpSession::freeBuf()
+{
+  deleteBuf( buf );
+  buf = NULL;
+}
+
+// Release the second buffer of pipelined download
+
+void FtpSession::freeBuf2()
+{
+  #ifdef FTP_RETR_PIPELINE
+    deleteBuf( buf2 );
+    buf2 = NULL;
+  #endif
+}
+
+// Data received is stored in buf and written to file when buf is full,
+//  by whole sectors of 512 bytes, so that the card never has to read,
+//  modify and write back a partial sector. The rest is written at the end
+
+bool FtpSession::doStore()
+{
+  #ifdef FTP_MODE_Z
+    if( unzip.active())
+      return doStoreZ();
+  #endif
+  int32_t na = data.available();
+  if( na > FTP_BUF_SIZE - nbBuf )
+    na = FTP_BUF_SIZE - nbBuf;
+  if( na > 0 )
+  {
+    uint32_t ra = rateAvailable();
+    int16_t nb = ra == 0 ? 0 : data.read( buf + nbBuf, (uint32_t) na < ra ? na : ra );
+    if( nb > 0 )
+    {
+      nbBuf += nb;
+      rateConsume( nb );
+      bytesTransfered += nb;
+    }
+  }
+  else if( ! data.connected())
+  {
+    if( ! writeStore( nbBuf ))
+      return false;
+    closeTransfer();
+    return false;
+  }
+  if( nbBuf < FTP_BUF_SIZE )
+    return true;
+  return writeStore( nbBuf - ( sectorOffset + nbBuf ) % 512 );
+}
+
+// Upload in MODE Z
+//  Data received is added to the input of unzip, and decompressed to buf
+//  which is written to file as in doStore()
+
+bool FtpSession::doStoreZ()
+{
+  #ifdef FTP_MODE_Z
+    uint16_t room;
+    uint8_t * pin = unzip.input( & room );
+    int32_t na = data.available();
+    if( na > room )
+      na = room;
+    if( na > 0 )
+    {
+      uint32_t ra = rateAvailable();
+      int16_t nb = ra == 0 ? 0 : data.read( pin, (uint32_t) na < ra ? na : ra );
+      if( nb > 0 )
+      {
+        unzip.added( nb );
+        rateConsume( nb );
+      }
+    }
+    int16_t nb = unzip.read( buf + nbBuf, FTP_BUF_SIZE - nbBuf );
+    if( nb < 0 )
+    {
+      if( unzip.error() == FtpInflate::ErrMemory )
+        FtpOutCli << F("451 Not enough memory for MODE Z") << endl;
+      else
+        FtpOutCli << F("451 Compressed data error") << endl;
+      closeFile();
+      data.stop();
+      return false;
+    }
+    nbBuf += nb;
+    bytesTransfered += nb;
+    if( nb == 0 && na <= 0 && nbBuf < FTP_BUF_SIZE && ! data.connected())
+    {
+      if( ! writeStore( nbBuf ))
+        return false;
+      if( unzip.done())
+        closeTransfer();
+      else
       {
-        #ifdef ESP8266
-        if( dataServer.hasClient())
-        {
-          data.stop();
-          data = dataServer.available();
-        }
-        #else
-        data = dataServer.accept();
-        #endif
-        delay( 1 );
+        FtpOutCli << F("451 Compressed data incomplete") << endl;
+        closeFile();
+        data.stop();
       }
+      return false;
     }
-    else if( dataConn == FTP_Active )
-      data.connect( dataIp, dataPort );
-
-  if( ! data.connected())
-    FtpOutCli << F("425 No data connection") << endl;
-  else if( out150 )
-    FtpOutCli << F("150 Accepted data connection to port ") << dataPort << endl;
-  
-  return data.connected();
+    if( nbBuf < FTP_BUF_SIZE )
+      return true;
+    return writeStore( nbBuf - ( sectorOffset + nbBuf ) % 512 );
+  #else
+    return false;
+  #endif
 }
 
-bool FtpServer::dataConnected()
-{
-  if( data.connected())
-    return true;
-  data.stop();
-  FtpOutCli << F("426 Data connection closed. Transfer aborted") << endl;
-  transferStage = FTP_Close;
-  return false;
-}
- 
-bool FtpServer::openDir( FTP_DIR * pdir )
-{
-  bool openD;
-  
-  if( cwdName == 0 )
-    openD = pdir->open( "/" );
-  else
-    openD = pdir->open( cwdName );
-  if( ! openD )
-    FtpOutCli << F("550 Can't open directory ") << cwdName << endl;
-  return openD;
-}
+// Write the nb first bytes of buf to file and move the rest to
+//  the beginning of buf
 
-bool FtpServer::doRetrieve()
+bool FtpSession::writeStore( uint16_t nb )
 {
-  if( ! dataConnected())
+  uint32_t t0 = server->statistics.clock();
+  if( nb > 0 && writeFile( buf, nb ) != nb )
   {
-    file.close();
+    FtpOutCli << F("552 Probably insufficient storage space") << endl;
+    closeFile();
+    data.stop();
     return false;
   }
-  int16_t nb = file.read( buf, FTP_BUF_SIZE );
   if( nb > 0 )
+    server->statistics.write( t0 );
+  storeCrc = FtpHash::crc32( storeCrc, buf, nb );
+  nbBuf -= nb;
+  memmove( buf, buf + nb, nbBuf );
+  sectorOffset = ( sectorOffset + nb ) % 512;
+  return true;
+}
+
+// Open file to be hashed from start to end by doHash()
+
+void FtpSession::beginHash( const char * path, uint8_t alg, uint64_t start, uint64_t end )
+{
+  if( st.isDir )
+    FtpOutCli << F("550 ") << parameter << F(" is a directory") << endl;
+  else if( start > end )
+    FtpOutCli << F("556 Invalid range") << endl;
+  else if( ! openFile( path, O_READ ))
+    FtpOutCli << F("450 Can't open ") << parameter << endl;
+  else if( start > 0 && ! seekFile( start ))
   {
-    data.write( buf, nb );
-    bytesTransfered += nb;
-    return true;
+    FtpOutCli << F("556 Invalid range") << endl;
+    closeFile();
+  }
+  else if( ! takeBuf())
+    closeFile();
+  else
+  {
+    hash.begin( alg );
+    hashStart = start;
+    hashPos = start;
+    hashEnd = end;
+    millisBeginTrans = millis();
+    bytesTransfered = 0;
+    transferStage = FTP_Hash;
   }
-  closeTransfer();
-  return false;
 }
 
-bool FtpServer::doStore()
+// Hash one buffer of file. The digest is sent when the end is reached
+
+bool FtpSession::doHash()
 {
-  int16_t na = data.available();
-  if( na == 0 )
-    if( data.connected())
-      return true;
-    else
+  if( hashPos < hashEnd )
+  {
+    uint16_t na = hashEnd - hashPos < FTP_BUF_SIZE ? hashEnd - hashPos : FTP_BUF_SIZE;
+    uint32_t t0 = server->statistics.clock();
+    int16_t nb = readFile( buf, na );
+    server->statistics.read( t0 );
+    if( nb <= 0 )
     {
-      closeTransfer();
+      FtpOutCli << F("451 Read error") << endl;
+      closeFile();
       return false;
     }
-  if( na > FTP_BUF_SIZE )
-    na = FTP_BUF_SIZE;
-  int16_t nb = data.read((uint8_t *) buf, na );
-  int16_t rc = 0;
-  if( nb > 0 )
-  {
-    // FtpDebug << millis() << " " << nb << endl;
-    rc = file.write( buf, nb );
+    hash.update( buf, nb );
+    hashPos += nb;
     bytesTransfered += nb;
-  }
-  if( nb < 0 || rc == nb  )
     return true;
-  FtpOutCli << F("552 Probably insufficient storage space") << endl;
-  file.close();
-  data.stop();
+  }
+  closeFile();
+  char hex[ FTP_HASH_HEX_SIZE ];
+  char startStr[ 21 ], endStr[ 21 ];
+  if( cmdKey == ftpKey( "HASH" ))
+    FtpOutCli << F("213 ") << FtpHash::name( hash.algorithm()) << ' '
+              << makeSizeStr( startStr, hashStart ) << '-'
+              << makeSizeStr( endStr, hashEnd > hashStart ? hashEnd - 1 : hashStart ) << ' '
+              << hash.end( hex ) << ' ' << parameter << endl;
+  else
+    FtpOutCli << F("250 ") << hash.end( hex, true ) << endl;
   return false;
 }
 
-bool FtpServer::doList()
+bool FtpSession::doList()
 {
   if( ! dataConnected())
   {
-    dir.close();
+    mount.closeDir();
     return false;
   }
-#if FTP_FILESYST == FTP_FATFS
-  if( dir.nextFile())
-  {
-    if( dir.isDir())
-      FtpOutData << F("+/,\t");
-    else
-      FtpOutData << F("+r,s") << long( dir.fileSize()) << F(",\t");
-    FtpOutData << dir.fileName() << endl;
-    nbMatch ++;
-    return true;
-  }
-#else
-  if( file.openNext( &dir, O_RDONLY ))
+  if( mount.nextEntry())
   {
-    if( file.isDir())
+    char sizeStr[ 21 ];
+    if( mount.entryIsDir())
       FtpOutData << F("+/,\t");
     else
-      FtpOutData << F("+r,s") << long( file.fileSize()) << F(",\t");
-    file.printName( & data );
+      FtpOutData << F("+r,s") << makeSizeStr( sizeStr, mount.entrySize()) << F(",\t");
+    mount.printEntryName( & bufPrint );
     FtpOutData << endl;
-    file.close();
+    mount.endEntry();
     nbMatch ++;
+    sendList( false );
     return true;
   }
-#endif
-  FtpOutCli << F("226 ") << nbMatch << F(" matches total") << endl;
-  dir.close();
-  data.stop();
+  sendList( true );
+  endList();
   return false;
 }
 
-bool FtpServer::doMlsd()
+bool FtpSession::doMlsd()
 {
   if( ! dataConnected())
   {
-    dir.close();
+    mount.closeDir();
     return false;
   }
-#if FTP_FILESYST == FTP_FATFS
-  if( dir.nextFile())
-  {
-    char dtStr[ 15 ];
-    FtpOutData << F("Type=") << ( dir.isDir() ? F("dir") : F("file"))
-               << F(";Modify=") << makeDateTimeStr( dtStr, dir.fileModDate(), dir.fileModTime()) 
-               << F(";Size=") << long( dir.fileSize())
-               << F("; ") << dir.fileName() << endl;
-    nbMatch ++;
-    return true;
-  }
-#else
-  if( file.openNext( &dir, O_RDONLY ))
+  if( mount.nextEntry())
   {
     char dtStr[ 15 ];
+    char sizeStr[ 21 ];
     uint16_t filelwd, filelwt;
-    bool gfmt = getFileModTime( & filelwd, & filelwt );
-    if( gfmt )
+    if( mount.entryModTime( & filelwd, & filelwt )) // else entry is skipped
     {
-		  FtpOutData << F("Type=") << ( file.isDir() ? F("dir") : F("file"))
-		             << F(";Modify=") << makeDateTimeStr( dtStr, filelwd, filelwt ) 
-		             << F(";Size=") << long( file.fileSize()) << F("; ");
-		  file.printName( & data );
-		  FtpOutData << endl;
+      FtpOutData << F("Type=") << ( mount.entryIsDir() ? F("dir") : F("file"))
+                 << F(";Modify=") << makeDateTimeStr( dtStr, filelwd, filelwt )
+                 << F(";Size=") << makeSizeStr( sizeStr, mount.entrySize()) << F("; ");
+      mount.printEntryName( & bufPrint );
+      FtpOutData << endl;
       nbMatch ++;
+      sendList( false );
     }
-    file.close();
-    return gfmt;
+    mount.endEntry();
+    return true;
   }
-#endif
-  FtpOutCli << F("226-options: -a -l") << endl;
+  sendList( true );
+  endList();
+  return false;
+}
+
+// Send the entries of listing waiting in buf when there is no more room
+//  for an other one, or at the end of listing
+
+void FtpSession::sendList( bool end )
+{
+  if( nbBuf > 0 && ( end || nbBuf > FTP_BUF_SIZE - ( FTP_ENTRY_SIZE )))
+  {
+    #if FTP_LIST_CACHE_SIZE > 0
+      if( cacheSlot >= 0 && ! server->listCache.append( cacheSlot, buf, nbBuf ))
+        cacheSlot = -1;
+    #endif
+    writeData( buf, nbBuf );
+    bytesTransfered += nbBuf;
+    nbBuf = 0;
+  }
+}
+
+void FtpSession::endList()
+{
+  if( transferStage == FTP_Mlsd )
+    FtpOutCli << F("226-options: -a -l") << endl;
   FtpOutCli << F("226 ") << nbMatch << F(" matches total") << endl;
-  dir.close();
+  server->statistics.transfer( transferStage, bytesTransfered, millis() - millisBeginTrans, true );
+  listCacheEnd( true );
+  mount.closeDir();
+  endModeZ( true );
   data.stop();
+}
+
+// Send next part of a listing found in cache
+
+bool FtpSession::doListCache()
+{
+  #if FTP_LIST_CACHE_SIZE > 0
+    if( ! dataConnected())
+      return false;
+    uint32_t nb = server->listCache.size( cacheSlot ) - cachePos;
+    if( nb > 0 )
+    {
+      if( nb > FTP_BUF_SIZE )
+        nb = FTP_BUF_SIZE;
+      writeData( server->listCache.data( cacheSlot ) + cachePos, nb );
+      cachePos += nb;
+      bytesTransfered += nb;
+      return true;
+    }
+    nbMatch = server->listCache.matches( cacheSlot );
+    endList();
+  #endif
   return false;
 }
 
-void FtpServer::closeTransfer()
+// Look for the listing of cwdName in cache. If it is not there, reserve
+//  a slot to store it while it is sent
+
+void FtpSession::listCacheBegin( ftpTransfer stage )
+{
+  #if FTP_LIST_CACHE_SIZE > 0
+    if( mount.dirInRam())               // files in RAM may be written by the sketch
+      return;
+    cachePos = 0;
+    cacheSlot = server->listCache.find( cwdName, stage );
+    cacheSend = cacheSlot >= 0;
+    if( cacheSend )
+      mount.closeDir();
+    else
+      cacheSlot = server->listCache.fill( cwdName, stage );
+  #endif
+}
+
+// Listing is terminated. Keep it in cache if it is complete
+
+void FtpSession::listCacheEnd( bool complete )
+{
+  #if FTP_LIST_CACHE_SIZE > 0
+    if( cacheSlot < 0 )
+      return;
+    if( cacheSend )
+      server->listCache.release( cacheSlot );
+    else if( complete )
+      server->listCache.commit( cacheSlot, nbMatch );
+    else
+      server->listCache.cancel( cacheSlot );
+    cacheSlot = -1;
+    cacheSend = false;
+  #endif
+}
+
+// File or directory path was created, changed or removed
+
+void FtpSession::listChanged( const char * path )
+{
+  st.valid = false;
+  #ifdef FTP_CWD_HANDLE
+    // current directory of a session may have been removed or renamed
+    size_t l = strlen( path );
+    for( uint8_t i = 0; i < FTP_MAX_SESSIONS; i ++ )
+    {
+      FtpSession & s = server->sessions[ i ];
+      if( ftpSamePath( s.cwdName, path, l ) && ( s.cwdName[ l ] == 0 || s.cwdName[ l ] == '/' ))
+        s.mount.closeCwd();
+    }
+  #endif
+  #if FTP_LIST_CACHE_SIZE > 0
+    server->listCache.invalidate( path );
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    server->fileCache.invalidate( path );
+  #endif
+}
+
+// In MODE Z, allocate the compression or decompression of the transfer
+//
+//  return false if there is not enough memory
+
+bool FtpSession::beginModeZ()
+{
+  #ifdef FTP_MODE_Z
+    if( modeZ )
+      return transferStage == FTP_Store ? unzip.begin() : zip.begin( data );
+  #endif
+  return true;
+}
+
+// Send nb bytes to the data connection, compressed in MODE Z
+
+void FtpSession::writeData( const uint8_t * b, uint16_t nb )
+{
+  #ifdef FTP_MODE_Z
+    if( zip.active())
+    {
+      zip.write( b, nb );
+      return;
+    }
+  #endif
+  data.write( b, nb );
+}
+
+// Release memory of MODE Z. If transfer is complete, the end of the
+//  compressed stream is sent before
+
+void FtpSession::endModeZ( bool complete )
+{
+  #ifdef FTP_MODE_Z
+    if( complete )
+      zip.finish();
+    zip.end();
+    unzip.end();
+  #endif
+}
+
+void FtpSession::closeTransfer()
 {
+  endModeZ( true );
+  closeFile();
+  freeBuf2();
+  if( transferStage == FTP_Store )      // CRC-32 of data received, computed by writeStore()
+  {
+    char hex[ FTP_HASH_HEX_SIZE ];
+    FtpOutCli << F("226-CRC32 ") << FtpHash::crcHex( storeCrc, hex ) << endl;
+  }
   uint32_t deltaT = (int32_t) ( millis() - millisBeginTrans );
+  server->statistics.transfer( transferStage, bytesTransfered, deltaT, true );
   if( deltaT > 0 && bytesTransfered > 0 )
   {
     #ifdef FTP_DEBUG
@@ -991,17 +2010,45 @@ void FtpServer::closeTransfer()
   }
   else
     FtpOutCli << F("226 File successfully transferred") << endl;
-  
-  file.close();
   data.stop();
 }
 
-void FtpServer::abortTransfer()
+// Close file, releasing the space allocated after its end
+
+void FtpSession::closeFile()
+{
+  preAllocated = false;
+  mount.close();
+  #if FTP_LIST_CACHE_SIZE > 0
+    if( storeDirHash != 0 )             // listing may have been read during upload
+      server->listCache.invalidateDir( storeDirHash );
+    storeDirHash = 0;
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( fileSlot >= 0 )
+      server->fileCache.release( fileSlot );
+    fileSlot = -1;
+    if( storeFileHash != 0 )            // file may have been read during upload
+      server->fileCache.invalidateHash( storeFileHash );
+    storeFileHash = 0;
+  #endif
+}
+
+void FtpSession::abortTransfer()
 {
   if( transferStage != FTP_Close )
   {
-    file.close();
-    dir.close();
+    if( transferStage == FTP_Store && nbBuf > 0 )
+      writeFile( buf, nbBuf );
+    if( transferStage != FTP_Connect && transferStage != FTP_Hash )
+      server->statistics.transfer( transferStage, bytesTransfered,
+                                   millis() - millisBeginTrans, false );
+    closeFile();
+    mount.closeDir();
+    freeBuf2();
+    listCacheEnd( false );
+    endModeZ( false );
+    freeBuf();
     FtpOutCli << F("426 Transfer aborted") << endl;
     #ifdef FTP_DEBUG
       FtpDebug << F(" Transfer aborted!") << endl;
@@ -1012,81 +2059,117 @@ void FtpServer::abortTransfer()
   data.stop(); 
 }
 
-// Read a char from client connected to ftp server
+// Read a command line from client connected to ftp server
+//
+//  All chars available from client are read at once and stored in cmdLine,
+//  that may hold several command lines sent without waiting for replies.
+//  They are returned one by one by successive calls
 //
-//  update cmdLine and command buffers, iCL and parameter pointers
+//  update cmdLine and command buffers, iCL, nextCL and parameter pointers
 //
 //  return:
-//    -2 if buffer cmdLine is full
+//    -2 if buffer cmdLine is full or syntax error
 //    -1 if line not completed
 //     0 if empty line received
-//    length of cmdLine (positive) if no empty line received 
+//    length of line (positive) if no empty line received 
 
-int8_t FtpServer::readChar()
+int16_t FtpSession::readLine()
 {
-  int8_t rc = -1;
+  int16_t rc = -1;
 
-  if( client.available())
+  // remove line returned by previous call
+  if( nextCL > 0 )
   {
-    char c = client.read();
-    #ifdef FTP_DEBUG
-      FtpDebug << c;
-    #endif
-    if( c == '\\' )
-      c = '/';
-    if( c != '\r' )
-      if( c != '\n' )
-      {
-        if( iCL < FTP_CMD_SIZE )
-          cmdLine[ iCL ++ ] = c;
-        else
-          rc = -2; //  Line too long
-      }
-      else
-      {
-        cmdLine[ iCL ] = 0;
-        command[ 0 ] = 0;
-        parameter = NULL;
-        // empty line?
-        if( iCL == 0 )
-          rc = 0;
-        else
-        {
-          rc = iCL;
-          // search for space between command and parameter
-          parameter = strchr( cmdLine, ' ' );
-          if( parameter != NULL )
-          {
-            if( parameter - cmdLine > 4 )
-              rc = -2; // Syntax error
-            else
-            {
-              strncpy( command, cmdLine, parameter - cmdLine );
-              command[ parameter - cmdLine ] = 0;
-              while( * ( ++ parameter ) == ' ' )
-                ;
-            }
-          }
-          else if( strlen( cmdLine ) > 4 )
-            rc = -2; // Syntax error.
-          else
-            strcpy( command, cmdLine );
-          iCL = 0;
-        }
-      }
-    if( rc > 0 )
-      for( uint8_t i = 0 ; i < strlen( command ); i ++ )
-        command[ i ] = toupper( command[ i ] );
-    if( rc == -2 )
+    iCL -= nextCL;
+    memmove( cmdLine, cmdLine + nextCL, iCL );
+    nextCL = 0;
+  }
+  char * eol = (char *) memchr( cmdLine, '\n', iCL );
+  if( eol == NULL && iCL < FTP_CMD_SIZE && client.available())
+  {
+    int16_t nb = client.read((uint8_t *) cmdLine + iCL, FTP_CMD_SIZE - iCL );
+    if( nb > 0 )
+    {
+      eol = (char *) memchr( cmdLine + iCL, '\n', nb );
+      iCL += nb;
+    }
+  }
+  // rest of a line too long: drop it
+  if( dropCL )
+  {
+    if( eol == NULL )
     {
       iCL = 0;
+      return rc;
+    }
+    dropCL = false;
+    nextCL = eol - cmdLine + 1;
+    return rc;
+  }
+  if( eol == NULL )
+  {
+    if( iCL >= FTP_CMD_SIZE )
+    {
+      iCL = 0; //  Line too long
+      dropCL = true;
       FtpOutCli << F("500 Syntax error") << endl;
+      rc = -2;
+    }
+    return rc;
+  }
+
+  nextCL = eol - cmdLine + 1;
+  if( eol > cmdLine && * ( eol - 1 ) == '\r' )
+    eol --;
+  * eol = 0;
+  #ifdef FTP_DEBUG
+    FtpDebug << cmdLine << endl;
+  #endif
+  for( char * p = cmdLine; p < eol; p ++ )
+    if( * p == '\\' )
+      * p = '/';
+  command[ 0 ] = 0;
+  parameter = NULL;
+  // empty line?
+  if( eol == cmdLine )
+    return 0;
+  rc = eol - cmdLine;
+  // search for space between command and parameter
+  parameter = strchr( cmdLine, ' ' );
+  if( parameter != NULL )
+  {
+    if( parameter - cmdLine > 5 )
+      rc = -2; // Syntax error
+    else
+    {
+      size_t l = parameter - cmdLine;
+      if( l > sizeof( command ) - 1 )
+        l = sizeof( command ) - 1;
+      memcpy( command, cmdLine, l );
+      command[ l ] = 0;
+      while( * ( ++ parameter ) == ' ' )
+        ;
+    }
+  }
+  else if( strlen( cmdLine ) > 5 )
+    rc = -2; // Syntax error.
+  else
+    strcpy( command, cmdLine );
+  if( rc > 0 )
+  {
+    cmdKey = 0;
+    for( uint8_t i = 0 ; i < strlen( command ); i ++ )
+    {
+      command[ i ] = toupper( command[ i ] );
+      cmdKey = ( cmdKey << 8 ) | (uint8_t) command[ i ];
     }
   }
+  else
+    FtpOutCli << F("500 Syntax error") << endl;
   return rc;
 }
 
-bool FtpServer::haveParameter()
+bool FtpSession::haveParameter()
 {
   if( parameter != NULL && strlen( parameter ) > 0 )
     return true;
@@ -1098,56 +2181,78 @@ bool FtpServer::haveParameter()
 //
 // 3 possible cases: param can be absolute path, relative path or only the name
 //
+// The path is built in one pass over param: empty names and '.' are
+//  skipped, '..' removes the previous name, and the length and the chars
+//  are checked as they are copied. The path never ends with '/', except
+//  for root
+//
 // parameter:
 //   fullName : where to store the path/name
 //
 // return:
 //    true, if done
 
-bool FtpServer::makePath( char * fullName, char * param )
+bool FtpSession::makePath( char * fullName, char * param )
 {
   if( param == NULL )
     param = parameter;
-    
-  // Root or empty?
-  if( strcmp( param, "/" ) == 0 || strlen( param ) == 0 )
+
+  uint16_t l = 0;                        // length of fullName, 0 for root
+  // If relative path, begin with current dir
+  if( * param != '/' )
   {
-    strcpy( fullName, "/" );
-    return true;
+    l = strlen( cwdName );
+    memcpy( fullName, cwdName, l );
+    while( l > 0 && fullName[ l - 1 ] == '/' )
+      l --;
   }
-  // If relative path, concatenate with current dir
-  if( param[0] != '/' ) 
+  while( * param != 0 )
   {
-    strcpy( fullName, cwdName );
-    if( fullName[ strlen( fullName ) - 1 ] != '/' )
-      strncat( fullName, "/", FTP_CWD_SIZE );
-    strncat( fullName, param, FTP_CWD_SIZE );
-  }
-  else
-    strcpy( fullName, param );
-  // If ends with '/', remove it
-  uint16_t strl = strlen( fullName ) - 1;
-  if( fullName[ strl ] == '/' && strl > 1 )
-    fullName[ strl ] = 0;
-  if( strlen( fullName ) >= FTP_CWD_SIZE )
-  {
-    FtpOutCli << F("500 Command line too long") << endl;
-    return false;
-  }
-  for( uint8_t i = 0; i < strlen( fullName ); i ++ )
-    if( ! legalChar( fullName[i]))
+    if( * param == '/' )
     {
-      FtpOutCli << F("553 File name not allowed") << endl;
-      return false;
+      param ++;
+      continue;
+    }
+    // copy one name, after a '/'
+    uint16_t lsep = l;
+    do
+    {
+      if( l + 1 >= FTP_CWD_SIZE )
+      {
+        FtpOutCli << F("500 Command line too long") << endl;
+        return false;
+      }
+      if( l == lsep )
+        fullName[ l ++ ] = '/';
+      else if( legalChar( * param ))
+        fullName[ l ++ ] = * param ++;
+      else
+      {
+        FtpOutCli << F("553 File name not allowed") << endl;
+        return false;
+      }
+    }
+    while( * param != 0 && * param != '/' );
+    if( l - lsep == 2 && fullName[ lsep + 1 ] == '.' )
+      l = lsep;                          // '.'
+    else if( l - lsep == 3 && fullName[ lsep + 1 ] == '.' && fullName[ lsep + 2 ] == '.' )
+    {
+      l = lsep;                          // '..'
+      while( l > 0 && fullName[ -- l ] != '/' )
+        ;
     }
+  }
+  if( l == 0 )
+    fullName[ l ++ ] = '/';
+  fullName[ l ] = 0;
   return true;
 }
 
-bool FtpServer::makeExistsPath( char * path, char * param )
+bool FtpSession::makeExistsPath( char * path, char * param )
 {
   if( ! makePath( path, param ))
     return false;
-  if( exists( path ))
+  if( statPath( path ))
     return true;
   FtpOutCli << F("550 ") << path << F(" not found.") << endl;
   return false;
@@ -1170,7 +2275,7 @@ bool FtpServer::makeExistsPath( char * path, char * param )
 // Date/time are expressed as a 14 digits long string
 //   terminated by a space and followed by name of file
 
-uint8_t FtpServer::getDateTime( char * dt, uint16_t * pyear, uint8_t * pmonth, uint8_t * pday,
+uint8_t FtpSession::getDateTime( char * dt, uint16_t * pyear, uint8_t * pmonth, uint8_t * pday,
                                 uint8_t * phour, uint8_t * pminute, uint8_t * psecond )
 {
   uint8_t i;
@@ -1220,7 +2325,7 @@ uint8_t FtpServer::getDateTime( char * dt, uint16_t * pyear, uint8_t * pmonth, u
 // return:
 //    pointer to tstr
 
-char * FtpServer::makeDateTimeStr( char * tstr, uint16_t date, uint16_t time )
+char * FtpSession::makeDateTimeStr( char * tstr, uint16_t date, uint16_t time )
 {
   sprintf( tstr, "%04u%02u%02u%02u%02u%02u",
            (( date & 0xFE00 ) >> 9 ) + 1980, ( date & 0x01E0 ) >> 5, date & 0x001F,
@@ -1228,72 +2333,150 @@ char * FtpServer::makeDateTimeStr( char * tstr, uint16_t date, uint16_t time )
   return tstr;
 }
 
-// Return true if path points to a directory
+// Create a string of decimal digits from a size or position in a file,
+//  that may be larger than 4 GB (Print has no 64 bits integers on all boards)
+//
+// parameters:
+//    size
+//    sstr: where to store the string. Must be at least 21 characters long
+//
+// return:
+//    pointer to the first digit, in sstr
 
-bool FtpServer::isDir( char * path )
+char * FtpSession::makeSizeStr( char * sstr, uint64_t size )
 {
-#if FTP_FILESYST == FTP_FATFS
-  return FTP_FS.isDir( path );
-#else
-  FTP_FILE file;
-  bool res;
-  
-  if( ! file.open( path, O_READ ))
-    return false;
-  res = file.isDir();
-  file.close();
-  return res;
-#endif
+  char * p = sstr + 20;
+  * p = 0;
+  do
+  {
+    * -- p = '0' + size % 10;
+    size /= 10;
+  }
+  while( size > 0 );
+  return p;
 }
 
-bool FtpServer::timeStamp( char * path, uint16_t year, uint8_t month, uint8_t day,
-                           uint8_t hour, uint8_t minute, uint8_t second )
+// Return true if path points to a directory
+
+// Read type, size and modification time of path
+//
+//  The result is kept until the end of the command, or until a file is
+//  changed, so that a command reads each path only once
+//
+//  return true if path exists
+
+bool FtpSession::statPath( const char * path )
 {
-#if FTP_FILESYST == FTP_FATFS
-  return FTP_FS.timeStamp( path, year, month, day, hour, minute, second );
-#else
-  FTP_FILE file;
-  bool res;
+  uint32_t hash = 2166136261UL;         // FNV-1a hash of path
+  for( const char * p = path; * p != 0; p ++ )
+    hash = ( hash ^ (uint8_t) * p ) * 16777619UL;
+  if( st.valid && st.path == path && st.hash == hash )
+    return st.exists;
+  st.path = path;
+  st.hash = hash;
+  st.valid = true;
+  st.isDir = false;
+  st.size = 0;
+  st.date = 0;
+  st.time = 0;
+  st.exists = mount.stat( path, & st.isDir, & st.size, & st.date, & st.time );
+  return st.exists;
+}
+
+// Open the file of a transfer. A small file opened to be read is taken from
+//  the cache of files, or is put in it if it is not in RAM
 
-  if( ! file.open( path, O_RDWR ))
+bool FtpSession::openFile( const char * path, int oflag )
+{
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( oflag == O_READ && ( fileSlot = server->fileCache.find( path )) >= 0 )
+    {
+      filePos = 0;
+      return true;
+    }
+  #endif
+  if( ! mount.open( path, oflag ))
     return false;
-  res = file.timestamp( T_WRITE, year, month, day, hour, minute, second );
-  file.close();
-  return res;
-#endif
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( oflag == O_READ && ! inRam())
+      cacheFile( path );
+  #endif
+  return true;
 }
-                        
-bool FtpServer::getFileModTime( char * path, uint16_t * pdate, uint16_t * ptime )
-{
-#if FTP_FILESYST == FTP_FATFS
-  return FTP_FS.getFileModTime( path, pdate, ptime );
-#else
-//  FTP_FILE file;
-  bool res;
 
-  if( ! file.open( path, O_READ ))
-    return false;
-  res = getFileModTime( pdate, ptime );
-  file.close();
-  return res;
+// Read whole file, that is open, into the cache of files if it is small
+//  enough. It is then closed and read from the cache
+
+#if FTP_FILE_CACHE_SIZE > 0
+void FtpSession::cacheFile( const char * path )
+{
+  uint64_t size = mount.fileSize();
+  if( size == 0 || size > FTP_FILE_CACHE_MAX )
+    return;
+  int8_t slot = server->fileCache.fill( path, size );
+  if( slot < 0 )
+    return;
+  uint8_t * p = server->fileCache.buffer( slot );
+  uint32_t n = 0;
+  int nb = 1;
+  uint32_t t0 = server->statistics.clock();
+  while( n < size && nb > 0 )
+  {
+    nb = mount.read( p + n, size - n < 0x4000 ? size - n : 0x4000 );
+    if( nb > 0 )
+      n += nb;
+  }
+  server->statistics.read( t0 );
+  if( n < size || ! mount.seekSet( 0 ))
+  {
+    server->fileCache.cancel( slot );
+    mount.seekSet( 0 );
+    return;
+  }
+  server->fileCache.commit( slot );
+  mount.close();
+  fileSlot = slot;
+  filePos = 0;
+}
 #endif
+
+// Read, seek and size of the file of a transfer
+
+int16_t FtpSession::readFile( uint8_t * b, uint16_t nb )
+{
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( inCache())
+    {
+      uint32_t size = server->fileCache.size( fileSlot );
+      if( nb > size - filePos )
+        nb = size - filePos;
+      memcpy( b, server->fileCache.data( fileSlot ) + filePos, nb );
+      filePos += nb;
+      return nb;
+    }
+  #endif
+  return mount.read( b, nb );
 }
 
-// Assume SD library is SdFat (or family) and file is open
-                        
-#if FTP_FILESYST != FTP_FATFS
-bool FtpServer::getFileModTime( uint16_t * pdate, uint16_t * ptime )
+bool FtpSession::seekFile( uint64_t pos )
 {
-#if FTP_FILESYST == FTP_SDFAT1 || FTP_FILESYST == FTP_SPIFM
-  dir_t d;
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( inCache())
+    {
+      if( pos > server->fileCache.size( fileSlot ))
+        return false;
+      filePos = pos;
+      return true;
+    }
+  #endif
+  return mount.seekSet( pos );
+}
 
-  if( ! file.dirEntry( & d ))
-    return false;
-  * pdate = d.lastWriteDate;
-  * ptime = d.lastWriteTime;
-  return true;
-#elif FTP_FILESYST == FTP_SDFAT2
-  return file.getModifyDateTime( pdate, ptime );
-#endif
+uint64_t FtpSession::fileSize()
+{
+  #if FTP_FILE_CACHE_SIZE > 0
+    if( inCache())
+      return server->fileCache.size( fileSlot );
+  #endif
+  return mount.fileSize();
 }
-#endif
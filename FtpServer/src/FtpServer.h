@@ -30,58 +30,65 @@
 #define FTP_SERVER_VERSION "2020-12-08"
 
 #include "FtpServerConfig.h"
-#include <SPI.h>
 
-#ifdef ESP8266
-  #include <ESP8266WiFi.h>
-  #include <WiFiClient.h>
+#ifdef FTP_HOST
+  #include <FtpHost.h>
 #else
-  #include <Ethernet.h>
+  #include <SPI.h>
+  #ifdef ESP8266
+    #include <ESP8266WiFi.h>
+    #include <WiFiClient.h>
+  #else
+    #include <Ethernet.h>
+  #endif
+  #include <sdios.h>
 #endif
 
-#include <sdios.h>
-
-#if FTP_FILESYST <= FTP_SDFAT2
-  #include <SdFat.h>
-  #define FTP_FS sd
-  #define FTP_FILE SdFile
-  #define FTP_DIR SdFile
-  extern SdFat FTP_FS;
-#elif FTP_FILESYST == FTP_SPIFM
-  #include <SdFat.h>
-  #include <Adafruit_SPIFlash.h>
-  #define FTP_FS fatfs
-  #define FTP_FILE File
-  #define FTP_DIR File
-  extern FatFileSystem FTP_FS;
-  extern Adafruit_SPIFlash flash;
-#elif FTP_FILESYST == FTP_FATFS
-  #include <FatFs.h>
-  #define FTP_FS sdff
-  #define FTP_FILE FileFs
-  #define FTP_DIR DirFs
-  extern FatFsClass FTP_FS;
-  #define O_READ     FA_READ
-  #define O_WRITE    FA_WRITE
-  #define O_RDWR     FA_READ | FA_WRITE
-  #define O_CREAT    FA_CREATE_ALWAYS
-  #define O_APPEND   FA_OPEN_APPEND
+#include "FtpFs.h"
+
+// Backends that can send a file to the data connection without copying it
+//  through buf. FTP_CLIENT must then have sendFile( FTP_FILE & file, size ),
+//  returning the bytes sent from the position of file (0 at end of file),
+//  or -1 if it can not. A board with DMA from the card to the network chip
+//  can define FTP_SENDFILE in the same way
+#if defined( FTP_HOST ) && FTP_FILESYST == FTP_POSIX
+  #define FTP_SENDFILE
 #endif
 
 #ifdef ESP8266
   #define FTP_SERVER WiFiServer
   #define FTP_CLIENT WiFiClient
   #define FTP_LOCALIP() WiFi.localIP()
-  #define CommandIs( a ) (command != NULL && ! strcmp_P( command, PSTR( a )))
+  #define FTP_SUBNETMASK() WiFi.subnetMask()
   #define ParameterIs( a ) ( parameter != NULL && ! strcmp_P( parameter, PSTR( a )))
 #else
-  #define FTP_SERVER EthernetServer
-  #define FTP_CLIENT EthernetClient
-  #define FTP_LOCALIP() Ethernet.localIP()
-  #define CommandIs( a ) ( ! strcmp_PF( command, PSTR( a )))
-  #define ParameterIs( a ) ( ! strcmp_PF( parameter, PSTR( a )))
+  #ifdef FTP_HOST
+    #define FTP_SERVER HostServer
+    #define FTP_CLIENT HostClient
+    #define FTP_LOCALIP() hostNet.localIP()
+    #define FTP_SUBNETMASK() hostNet.subnetMask()
+  #else
+    #define FTP_SERVER EthernetServer
+    #define FTP_CLIENT EthernetClient
+    #define FTP_LOCALIP() Ethernet.localIP()
+    #define FTP_SUBNETMASK() Ethernet.subnetMask()
+  #endif
+  #define ParameterIs( a ) ( parameter != NULL && ! strcmp_PF( parameter, PSTR( a )))
 #endif
 
+// Key of a command: its 3 to 5 chars packed in an integer, so that
+//  commands can be used as labels of a switch
+constexpr uint64_t ftpKey( const char * cmd, uint64_t key = 0 )
+{
+  return * cmd == 0 ? key : ftpKey( cmd + 1, ( key << 8 ) | (uint8_t) * cmd );
+}
+
+// Compare the n first chars of two paths, ignoring case if the files system does
+inline bool ftpSamePath( const char * a, const char * b, size_t n )
+{
+  return FtpFs::caseSensitive() ? ! strncmp( a, b, n ) : ! strncasecmp( a, b, n );
+}
+
 #define FTP_USER "arduino"        // Default user'name
 #define FTP_PASS "test"           // Default password
 
@@ -93,6 +100,7 @@
 #define FTP_CMD_SIZE FF_MAX_LFN+8 // max size of a command
 #define FTP_CWD_SIZE FF_MAX_LFN+8 // max size of a directory name
 #define FTP_FIL_SIZE FF_MAX_LFN   // max size of a file name 
+#define FTP_ENTRY_SIZE FTP_FIL_SIZE+64 // max size of a line of listing
 #define FTP_CRED_SIZE 16          // max size of username and password
 #define FTP_NULLIP() IPAddress(0,0,0,0)
 
@@ -108,7 +116,9 @@ enum ftpTransfer { FTP_Close = 0, // In this stage, close data channel
                    FTP_Store,     //  store file
                    FTP_List,      //  list of files
                    FTP_Nlst,      //  list of name of files
-                   FTP_Mlsd };    //  listing for machine processing
+                   FTP_Mlsd,      //  listing for machine processing
+                   FTP_Connect,   //  wait for data connection
+                   FTP_Hash };    //  checksum of file (no data connection)
 
 enum ftpDataConn { FTP_NoConn = 0,// No data connexion
                    FTP_Pasive,    // Pasive type
@@ -122,108 +132,403 @@ class FtpFile : public SdFile
 };
 */
 
-class FtpServer
+#include "FtpListCache.h"
+#include "FtpRamFs.h"
+#include "FtpFsMount.h"
+#include "FtpFileCache.h"
+#include "FtpDeflate.h"
+#include "FtpHash.h"
+#include "FtpStats.h"
+
+class FtpServer;
+
+// Print to a memory buffer
+//  nb is the number of bytes in the buffer. Bytes that do not fit are lost
+
+class FtpPrintBuffer : public Print
 {
 public:
-  FtpServer( uint16_t _cmdPort = FTP_CMD_PORT, uint16_t _pasvPort = FTP_DATA_PORT_PASV );
+  FtpPrintBuffer( uint8_t * & _pbuf, uint16_t _size, uint16_t & _nb )
+                : pbuf( _pbuf ), size( _size ), nb( _nb ) {};
+  size_t write( uint8_t c )
+  {
+    if( nb >= size )
+      return 0;
+    pbuf[ nb ++ ] = c;
+    return 1;
+  };
+  size_t write( const uint8_t * b, size_t n )
+  {
+    if( n > (size_t) ( size - nb ))
+      n = size - nb;
+    memcpy( pbuf + nb, b, n );
+    nb += n;
+    return n;
+  };
 
-  void    init( IPAddress _localIP = FTP_NULLIP() );
-  void    credentials( const char * _user, const char * _pass );
-  uint8_t service();
+private:
+  uint8_t * & pbuf;                   // buffer may change between transfers
+  uint16_t  size;
+  uint16_t & nb;
+};
+
+// Fixed pool of FTP_BUF_POOL buffers of FTP_BUF_SIZE bytes
+
+class FtpBufPool
+{
+public:
+  FtpBufPool() : used( 0 ) {};
+  uint8_t * take()                    // return NULL if all buffers are used
+  {
+    #if FTP_BUF_POOL > 0
+      for( uint8_t i = 0; i < FTP_BUF_POOL; i ++ )
+        if( ! ( used & ( 1UL << i )))
+        {
+          used |= 1UL << i;
+          return blocks[ i ];
+        }
+    #endif
+    return NULL;
+  };
+  bool      give( uint8_t * b )       // return false if b is not from the pool
+  {
+    #if FTP_BUF_POOL > 0
+      for( uint8_t i = 0; i < FTP_BUF_POOL; i ++ )
+        if( b == blocks[ i ] )
+        {
+          used &= ~ ( 1UL << i );
+          return true;
+        }
+    #endif
+    return false;
+  };
 
 private:
+  #if FTP_BUF_POOL > 0
+  uint8_t  __attribute__((aligned(4))) // need to be aligned to 32bit for Esp8266 SPIClass::transferBytes()
+           blocks[ FTP_BUF_POOL ][ FTP_BUF_SIZE ];
+  #endif
+  uint32_t used;                      // bit i is set when blocks[ i ] is taken
+};
+
+// Print to client by whole replies
+//  Chars are stored until send() is called, so that a reply of several
+//  lines or fragments goes in one TCP segment
+//  With FTP_STATS, the code of the last line of each reply is counted
+
+class FtpReplyBuffer : public Print
+{
+public:
+  FtpReplyBuffer( FTP_CLIENT & _client ) : client( _client ), nb( 0 ), col( 0 ), code( 0 ) {};
+  void   setStats( FtpStats * _stats ) { stats = _stats; };
+  size_t write( uint8_t c ) { return write( & c, 1 ); };
+  size_t write( const uint8_t * b, size_t n )
+  {
+    size_t nw = n;
+    #ifdef FTP_STATS
+      for( size_t i = 0; i < n; i ++ )
+        if( b[ i ] == '\n' )
+          col = code = 0;
+        else if( col < 3 && isdigit( b[ i ] ))
+        {
+          code = code * 10 + b[ i ] - '0';
+          col ++;
+        }
+        else if( col < 3 )                // not a line with a code
+          col = 4;
+        else if( col == 3 )
+        {
+          if( b[ i ] == ' ' )
+            stats->reply( code );
+          col = 4;
+        }
+    #endif
+    while( n > 0 )
+    {
+      if( nb >= FTP_REPLY_SIZE )
+        send();
+      uint16_t nc = n < (size_t) ( FTP_REPLY_SIZE - nb ) ? n : FTP_REPLY_SIZE - nb;
+      memcpy( pbuf + nb, b, nc );
+      nb += nc;
+      b += nc;
+      n -= nc;
+    }
+    return nw;
+  };
+  void send()
+  {
+    if( nb > 0 )
+      client.write( pbuf, nb );
+    nb = 0;
+  };
+
+private:
+  FTP_CLIENT & client;
+  FtpStats * stats;
+  uint8_t   pbuf[ FTP_REPLY_SIZE ];
+  uint16_t  nb;
+  uint8_t   col;                      // position in line (4 after the code)
+  uint16_t  code;                     // code of line
+};
+
+// Token bucket limiting a flow of data to rate bytes per second
+//  Tokens are added with time, up to a burst of FTP_RATE_BURST_MS ms of
+//  data (at least 512 bytes), and each byte moved takes one token.
+//  A rate of 0 is not limited
+
+class FtpRate
+{
+public:
+  FtpRate() : rate( 0 ) {};
+  void     set( uint32_t _rate )
+  {
+    rate = _rate;
+    tokens = burst();
+    last = millis();
+  };
+  uint32_t get() { return rate; };
+  uint32_t available()                // bytes that can be moved now
+  {
+    if( rate == 0 )
+      return UINT32_MAX;
+    uint32_t now = millis();
+    uint64_t add = (uint64_t) rate * (uint32_t) ( now - last ) / 1000;
+    if( add > 0 )                     // else wait for at least one token
+    {
+      tokens = add < burst() - tokens ? tokens + (uint32_t) add : burst();
+      last = now;
+    }
+    return tokens;
+  };
+  void     consume( uint32_t nb )
+  {
+    if( rate > 0 )
+      tokens = nb < tokens ? tokens - nb : 0;
+  };
+
+private:
+  uint32_t burst()
+  {
+    uint32_t b = rate / 1000 * FTP_RATE_BURST_MS;
+    return b < 512 ? 512 : b;
+  };
+
+  uint32_t rate,
+           tokens,
+           last;                      // time of last addition of tokens
+};
+
+// Type, size and modification time of a path, read once by command
+
+struct FtpStat
+{
+  const char * path;                  // path, and its hash to detect changes
+  uint32_t hash;
+  bool     valid,
+           exists,
+           isDir;
+  uint64_t size;
+  uint16_t date,                      // modification time, 0 if unknown
+           time;
+};
+
+// State of one client connected to the server
+
+class FtpSession
+{
+  friend class FtpServer;
+
+public:
+  FtpSession();
+
+  // status of the session as returned by FtpServer::service()
+  uint8_t status() { return cmdStage | ( transferStage << 3 ) | ( dataConn << 6 ); };
+  uint8_t activity() { return ( transferStage != FTP_Close ) << 3 | cmdStage; };
+
+private:
+  void    begin( FtpServer * _server, uint16_t _pasvPort );
+  void    connect( FTP_CLIENT & newClient );
+  uint8_t service();
   void    iniVariables();
   void    clientConnected();
   void    disconnectClient();
   bool    processCommand();
+  void    cmdUser();
+  void    cmdPass();
+  void    cmdFeat();
+  void    cmdAuth();
+  void    cmdPwd();
+  void    cmdCdup();
+  void    cmdCwd();
+  void    cmdQuit();
+  void    cmdMode();
+  void    cmdPasv();
+  void    cmdPort();
+  void    cmdStru();
+  void    cmdType();
+  void    cmdAbor();
+  void    cmdDele();
+  void    cmdList();
+  void    cmdMlst();
+  void    cmdNoop();
+  void    cmdRetr();
+  void    cmdRest();
+  void    cmdAllo();
+  void    cmdStor();
+  void    cmdMkd();
+  void    cmdRmd();
+  void    cmdRnfr();
+  void    cmdRnto();
+  void    cmdMdtm();
+  void    cmdSize();
+  void    cmdSite();
+  void    cmdOpts();
+  void    cmdRang();
+  void    cmdHash();
+  void    cmdXcrc();
   bool    haveParameter();
-  int     dataConnect( bool out150 = true );
+  bool    dataConnect( ftpTransfer stage, bool out150 = true );
+  bool    doConnect();
   bool    dataConnected();
+  bool    doTransfer();
+  bool    transferWouldBlock();
+  uint32_t rateAvailable();
+  void    rateConsume( uint32_t nb );
   bool    doRetrieve();
+  bool    doRetrievePipe();
+  bool    takeBuf();
+  void    freeBuf();
+  uint8_t * newBuf();
+  void    deleteBuf( uint8_t * b );
+  void    freeBuf2();
+  bool    seekRestart();
   bool    doStore();
+  bool    doStoreZ();
+  bool    writeStore( uint16_t nb );
   bool    doList();
   bool    doMlsd();
+  void    beginHash( const char * path, uint8_t alg, uint64_t start, uint64_t end );
+  bool    doHash();
+  void    sendList( bool end );
+  void    endList();
+  bool    doListCache();
+  void    listCacheBegin( ftpTransfer stage );
+  void    listCacheEnd( bool complete );
+  void    listChanged( const char * path );
+  bool    beginModeZ();
+  void    writeData( const uint8_t * b, uint16_t nb );
+  void    endModeZ( bool complete );
   void    closeTransfer();
+  void    closeFile();
   void    abortTransfer();
   bool    makePath( char * fullName, char * param = NULL );
   bool    makeExistsPath( char * path, char * param = NULL );
-  bool    openDir( FTP_DIR * pdir );
-  bool    isDir( char * path );
+  bool    openDir();
   uint8_t getDateTime( char * dt, uint16_t * pyear, uint8_t * pmonth, uint8_t * pday,
                        uint8_t * phour, uint8_t * pminute, uint8_t * second );
   char *  makeDateTimeStr( char * tstr, uint16_t date, uint16_t time );
-  bool    timeStamp( char * path, uint16_t year, uint8_t month, uint8_t day,
-                     uint8_t hour, uint8_t minute, uint8_t second );
-  bool    getFileModTime( char * path, uint16_t * pdate, uint16_t * ptime );
-#if FTP_FILESYST != FTP_FATFS
-  bool    getFileModTime( uint16_t * pdate, uint16_t * ptime );
+  char *  makeSizeStr( char * sstr, uint64_t size );
+  bool    statPath( const char * path );
+  bool    openFile( const char * path, int oflag = O_READ );
+  int16_t readLine();
+
+  // File of transfer, in the cache of files or in the files systems
+  bool     inRam() { return mount.inRam(); };
+  size_t   writeFile( const uint8_t * b, uint16_t nb ) { return mount.write( b, nb ); };
+#if FTP_FILE_CACHE_SIZE > 0
+  bool     inCache() { return fileSlot >= 0; };
+  void     cacheFile( const char * path );
+#else
+  bool     inCache() { return false; };
 #endif
-  int8_t  readChar();
-
-  bool     exists( const char * path ) { return FTP_FS.exists( path ); };
-  bool     remove( const char * path ) { return FTP_FS.remove( path ); };
-  bool     makeDir( const char * path ) { return FTP_FS.mkdir( path ); };
-  bool     removeDir( const char * path ) { return FTP_FS.rmdir( path ); };
-  bool     rename( const char * path, const char * newpath )
-             { return FTP_FS.rename( path, newpath ); };
-#if FTP_FILESYST == FTP_SDFAT1
-  uint32_t capacity() { return FTP_FS.card()->cardSize() >> 1; };
-  uint32_t free() { return FTP_FS.vol()->freeClusterCount() * 
-                           FTP_FS.vol()->sectorsPerCluster() >> 1; };
-#elif FTP_FILESYST == FTP_SDFAT2
-  uint32_t capacity() { return FTP_FS.card()->sectorCount() >> 1; };
-  uint32_t free() { return FTP_FS.vol()->freeClusterCount() * 
-                           FTP_FS.vol()->sectorsPerCluster() >> 1; };
-#elif FTP_FILESYST == FTP_SPIFM
-  uint32_t capacity() { return flash.size() >> 10; };
-  uint32_t free() { return 0; };    // TODO //
-#elif FTP_FILESYST == FTP_FATFS
-  uint32_t capacity() { return FTP_FS.capacity(); };
-  uint32_t free() { return FTP_FS.free(); };
+  int16_t  readFile( uint8_t * b, uint16_t nb );
+  bool     seekFile( uint64_t pos );
+  uint64_t fileSize();
+#ifdef FTP_SENDFILE
+  long     sendFile( uint32_t size )
+             { return inCache() ? -1 : mount.sendFile( data, size ); };
+#else
+  long     sendFile( uint32_t size ) { return -1; };
 #endif
 	bool    legalChar( char c ) // Return true if char c is allowed in a long file name
 	{
 		if( c == '"' || c == '*' || c == '?' || c == ':' || 
 		    c == '<' || c == '>' || c == '|' )
 		  return false;
-#if FTP_FILESYST == FTP_FATFS
-		return 0x1f < c && c < 0xff;
-#else
-		return 0x1f < c && c < 0x7f;
-#endif
+		return FtpFs::legalChar( c );
 	}
   
-  IPAddress   localIp;                // IP address of server as seen by clients
+  FtpServer * server;                 // server owning this session
   IPAddress   dataIp;                 // IP address of client for data
-  FTP_SERVER  ftpServer;
   FTP_SERVER  dataServer;
   FTP_CLIENT  client;
   FTP_CLIENT  data;
   
-  FTP_FILE     file;
-  FTP_DIR      dir;
+  FtpFsMount  mount;                  // files and directories of the session
   
   ftpCmd      cmdStage;               // stage of ftp command connexion
   ftpTransfer transferStage;          // stage of data connexion
+  ftpTransfer connectStage;           // stage of transfer when data is connected
   ftpDataConn dataConn;               // type of data connexion
+  bool        modeZ;                  // transfers are compressed (MODE Z)
+  bool        zeroCopy;               // RETR is sent by sendFile(), without buf
+  #ifdef FTP_MODE_Z
+  FtpDeflate  zip;                    // compression of downloads and listings
+  FtpInflate  unzip;                  // decompression of uploads
+  #endif
 
+  FtpPrintBuffer   bufPrint;          // listings are formatted in buf
+  FtpReplyBuffer   replyBuf;          // replies are assembled in replyBuf
   ArduinoOutStream FtpOutCli;
   ArduinoOutStream FtpOutData;
   
-  uint8_t  __attribute__((packed, aligned(4))) // need to be aligned to 32bit for Esp8266 SPIClass::transferBytes()
-           buf[ FTP_BUF_SIZE ];       // data buffer for transfers
+  uint8_t * buf;                      // data buffer of transfer, from pool (NULL if none)
+  #ifdef FTP_RETR_PIPELINE
+  uint8_t * buf2;                     // second buffer for pipelined download (NULL if not allocated)
+  uint8_t * bufSend;                  // buffer being sent (buf or buf2)
+  uint16_t nbSend,                    // number of bytes in bufSend
+           iSend,                     // number of bytes of bufSend already sent
+           nbRead;                    // number of bytes read from file in the other buffer
+  bool     eofRead;                   // end of file reached
+  #endif
   char     cmdLine[ FTP_CMD_SIZE ];   // where to store incoming char from client
   char     cwdName[ FTP_CWD_SIZE ];   // name of current directory
   char     rnfrName[ FTP_CWD_SIZE ];  // name of file for RNFR command
-  char     user[ FTP_CRED_SIZE ];     // user name
-  char     pass[ FTP_CRED_SIZE ];     // password
-  char     command[ 5 ];              // command sent by client
+  char     command[ 6 ];              // command sent by client
+  uint64_t cmdKey;                    // command packed by ftpKey()
   bool     rnfrCmd;                   // previous command was RNFR
   char *   parameter;                 // point to begin of parameters sent by client
-  uint16_t cmdPort,
-           pasvPort,
+  FtpStat  st;                        // last path read by statPath()
+  uint16_t pasvPort,
            dataPort;
-  uint16_t iCL;                       // pointer to cmdLine next incoming char
+  uint32_t allocSize;                 // size given by ALLO for next STOR
+  bool     preAllocated;              // space was allocated to file being stored
+  uint64_t restartPos;                // position given by REST for next RETR or STOR
+  FtpHash  hash;                      // digest computed by HASH, XCRC, XMD5 or XSHA1
+  uint8_t  hashAlg;                   // algorithm of HASH, chosen by OPTS HASH
+  uint64_t rangeStart,                // range given by RANG for next HASH
+           rangeEnd,                  //  (0 to 0 for whole file)
+           hashStart,                 // first byte of file to hash
+           hashPos,                   // next byte of file to hash
+           hashEnd;                   // end of bytes to hash
+  uint32_t storeCrc;                  // CRC-32 of data stored by STOR or APPE
+  FtpRate  rate;                      // limit of bandwidth of current transfer
+  #if FTP_LIST_CACHE_SIZE > 0
+  int8_t   cacheSlot;                 // slot of listing cache being filled or sent
+  bool     cacheSend;                 // listing is sent from cache
+  uint32_t cachePos;                  // bytes of listing already sent from cache
+  uint32_t storeDirHash;              // hash of directory of file being stored
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+  int8_t   fileSlot;                  // slot of file cache read by RETR or HASH, -1 if none
+  uint32_t filePos;                   // position in this file
+  uint32_t storeFileHash;             // hash of path of file being stored
+  #endif
+  uint16_t nbBuf,                     // number of bytes waiting in buf (upload or listing)
+           sectorOffset;              // position in its sector of the first byte of buf
+  uint16_t iCL,                       // pointer to cmdLine next incoming char
+           nextCL;                    // begin in cmdLine of next command line
+  bool     dropCL;                    // rest of a command line too long is dropped
   uint16_t nbMatch;
 
   uint32_t millisDelay,               //
@@ -232,4 +537,53 @@ private:
            bytesTransfered;           //
 };
 
+class FtpServer
+{
+  friend class FtpSession;
+
+public:
+  FtpServer( uint16_t _cmdPort = FTP_CMD_PORT, uint16_t _pasvPort = FTP_DATA_PORT_PASV );
+
+  void    init( IPAddress _localIP = FTP_NULLIP() );
+  void    credentials( const char * _user, const char * _pass );
+  uint8_t service();
+  uint8_t status( uint8_t n );         // status of session n
+  void    rates( uint32_t transfer, uint32_t total ); // limits in bytes/s (0: none)
+  uint8_t * takeBuffer() { return bufPool.take(); };  // lend a free buffer of the pool
+  void    giveBuffer( uint8_t * b ) { bufPool.give( b ); };
+  #ifdef FTP_STATS
+  const FtpStats & stats() { return statistics; };
+  void    clearStats() { statistics.clear(); };
+  #endif
+  #if FTP_RAM_FS_SIZE > 0
+  FtpRamFs & ram() { return ramFs; }; // files of FTP_RAM_MOUNT, for the sketch
+  #endif
+  void    fileChanged( const char * path ); // path was changed by the sketch
+
+private:
+  IPAddress   localIp;                // IP address of server as seen by clients
+  FTP_SERVER  ftpServer;
+
+  FtpSession  sessions[ FTP_MAX_SESSIONS ];
+  #if FTP_LIST_CACHE_SIZE > 0
+  FtpListCache listCache;             // listings shared by all sessions
+  #endif
+  #if FTP_RAM_FS_SIZE > 0
+  FtpRamFs    ramFs;                  // files of FTP_RAM_MOUNT
+  #endif
+  #if FTP_FILE_CACHE_SIZE > 0
+  FtpFileCache fileCache;             // small files shared by all sessions
+  #endif
+  uint8_t     iSession;               // last session served first by service()
+  FtpStats    statistics;             // counters of all sessions (empty without FTP_STATS)
+  uint32_t    rateTransfer;           // limit of each transfer (bytes/s)
+  FtpBufPool  bufPool;                // buffers of transfers
+  FtpRate     rateTotal;              // limit of all transfers
+
+  char     user[ FTP_CRED_SIZE ];     // user name
+  char     pass[ FTP_CRED_SIZE ];     // password
+  uint16_t cmdPort,
+           pasvPort;
+};
+
 #endif // FTP_SERVER_H
@@ -32,8 +32,13 @@
 #define FTP_SDFAT2 1 // Library SdFat version >= 2.0.2
 #define FTP_SPIFM  2 // Libraries Adafruit_SPIFlash and SdFat-Adafruit-Fork
 #define FTP_FATFS  3 // Library FatFs
+#define FTP_POSIX  4 // Directory of the host (build for Linux, see extras/host)
 // Select one of the previous files system
-#define FTP_FILESYST FTP_SDFAT2
+#ifdef FTP_HOST
+  #define FTP_FILESYST FTP_POSIX
+#else
+  #define FTP_FILESYST FTP_SDFAT2
+#endif
 
 
 // Uncomment to print debugging info to console attached to Arduino
@@ -61,7 +66,162 @@
 // Transfer speed depends of this value
 // Best value depends on many factors: SD card, client side OS, ... 
 // But it can be reduced to 512 if memory usage is critical.
-#define FTP_BUF_SIZE 2048 //1024 // 512  
+// Uploaded data is written to file by whole sectors, so it can not be less than 512
+#ifndef FTP_BUF_SIZE
+  #define FTP_BUF_SIZE 2048 //1024 // 512  
+#endif
+#if FTP_BUF_SIZE < 512
+  #error FTP_BUF_SIZE must be at least 512
+#endif
+
+// Size of the buffer where replies to client are assembled
+// A reply is sent by one write when it is complete, or when the buffer is full
+#ifndef FTP_REPLY_SIZE
+  #define FTP_REPLY_SIZE 256
+#endif
+
+// Pipelined download (RETR)
+// While a file is sent, a second buffer of FTP_BUF_SIZE bytes is allocated
+//  so that the next chunk is read from the card while the previous one is
+//  still sent by the ethernet chip. The client must support availableForWrite()
+// If there is not enough memory, the file is sent with one buffer only
+// Comment out to never allocate this second buffer
+#define FTP_RETR_PIPELINE
+
+
+// Cache of directory listings
+// Last listings are kept in RAM, shared by all sessions, and are sent again
+//  without reading the directory until a file of this directory is changed.
+// FTP_LIST_CACHE_SIZE is the maximum number of bytes used (0 to disable),
+//  FTP_LIST_CACHE_SLOTS the maximum number of listings
+// On Esp32 with PSRAM, define FTP_LIST_CACHE_REALLOC as ps_realloc
+#ifndef FTP_LIST_CACHE_SIZE
+  #define FTP_LIST_CACHE_SIZE 0
+#endif
+#define FTP_LIST_CACHE_SLOTS 4
+#define FTP_LIST_CACHE_REALLOC realloc
+
+
+// File system in RAM
+// Files of the directory FTP_RAM_MOUNT are kept in RAM instead of the files
+//  system: they are transferred at the speed of the network and do not wear
+//  the card. This directory has no subdirectory.
+// FTP_RAM_FS_SIZE is the number of bytes of the pool (0 to disable), divided
+//  in blocks of FTP_RAM_BLOCK bytes, for up to FTP_RAM_FILES files with names
+//  shorter than FTP_RAM_NAME. The pool is allocated by init()
+// On Esp32 with PSRAM, define FTP_RAM_MALLOC as ps_malloc
+#ifndef FTP_RAM_FS_SIZE
+  #define FTP_RAM_FS_SIZE 0
+#endif
+#define FTP_RAM_MOUNT "/ram"
+#define FTP_RAM_FILES 16
+#define FTP_RAM_NAME  32
+#define FTP_RAM_BLOCK 512
+#define FTP_RAM_MALLOC malloc
+
+
+// Cache of small files
+// Files of at most FTP_FILE_CACHE_MAX bytes are kept in RAM the first time
+//  they are read (RETR, HASH), shared by all sessions, and are sent again
+//  without opening them until they are written, removed or renamed by a
+//  client. A sketch that changes such a file must call fileChanged()
+// FTP_FILE_CACHE_SIZE is the maximum number of bytes used (0 to disable),
+//  FTP_FILE_CACHE_SLOTS the maximum number of files. The least recently
+//  used file is removed first
+// On Esp32 with PSRAM, define FTP_FILE_CACHE_MALLOC as ps_malloc
+#ifndef FTP_FILE_CACHE_SIZE
+  #define FTP_FILE_CACHE_SIZE 0
+#endif
+#define FTP_FILE_CACHE_SLOTS 8
+#define FTP_FILE_CACHE_MAX   4096
+#define FTP_FILE_CACHE_MALLOC malloc
+
+
+// Keep the current directory open
+// Files and directories inside the current directory are then opened from
+//  it, instead of walking their path from root directory at each command.
+// Each session needs one more file object. Not available with FatFs
+//#define FTP_CWD_HANDLE
+
+
+// Compression of transfers (MODE Z)
+// When the client asks for MODE Z, downloads and listings are compressed
+//  with a window of 1 << FTP_MODE_Z_WBITS bytes (9 to 14), and uploads are
+//  decompressed. While a compressed transfer is in progress, the session
+//  allocates 3 << FTP_MODE_Z_WBITS bytes to compress, or about 2.5 kbytes
+//  plus the window chosen by the client (32 kbytes for zlib) to decompress
+//#define FTP_MODE_Z
+#ifndef FTP_MODE_Z_WBITS
+  #define FTP_MODE_Z_WBITS 11
+#endif
+
+
+// Checksums (HASH, XCRC, XMD5, XSHA1 and CRC-32 of uploads)
+// CRC-32 is computed byte by byte with a table of 1 kbyte in flash.
+// Define FTP_CRC_SLICE8 to compute it 8 bytes at once, about 3 times faster,
+//  with 8 kbytes of RAM filled at first use
+//#define FTP_CRC_SLICE8
+
+
+// Runtime statistics
+// Define FTP_STATS to count commands and their time, errors by reply code,
+//  bytes transferred, and to keep histograms of the time to connect, to read
+//  and write files, and of the speed of transfers. They are read with
+//  FtpServer::stats() or the command SITE STATS, and need about 1.5 kbytes
+//#define FTP_STATS
+
+
+// Budget of one call to service() for transfers
+// Data is moved by chunks of FTP_BUF_SIZE bytes (or by directory entries)
+//  until FTP_SERVICE_MS milliseconds are spent, FTP_SERVICE_BYTES bytes are
+//  moved or the data connection would block.
+// Set FTP_SERVICE_MS to 0 to move only one chunk by call
+#ifndef FTP_SERVICE_MS
+  #define FTP_SERVICE_MS 10
+#endif
+#ifndef FTP_SERVICE_BYTES
+  #define FTP_SERVICE_BYTES 32768
+#endif
+
+
+// Limits of bandwidth of RETR and STOR, in bytes per second (0 for no limit)
+// FTP_RATE_TRANSFER limits each transfer and FTP_RATE_TOTAL all transfers of
+//  all sessions. Both can be changed with FtpServer::rates() or SITE RATE.
+// Data is moved by bursts of up to FTP_RATE_BURST_MS milliseconds of the rate
+#ifndef FTP_RATE_TRANSFER
+  #define FTP_RATE_TRANSFER 0
+#endif
+#ifndef FTP_RATE_TOTAL
+  #define FTP_RATE_TOTAL 0
+#endif
+#ifndef FTP_RATE_BURST_MS
+  #define FTP_RATE_BURST_MS 50
+#endif
+
+
+// Number of clients that can be connected at the same time
+// Each session needs about 1 kbytes of RAM, a buffer of FTP_BUF_SIZE bytes during
+//  transfers, and up to three sockets of the ethernet chip (command,
+//  passive listener, data)
+// Session n listens for passive data connections on port pasvPort + n
+#ifndef FTP_MAX_SESSIONS
+  #define FTP_MAX_SESSIONS 1
+#endif
+
+// Pool of file buffers
+// A session takes a buffer of FTP_BUF_SIZE bytes when a transfer begins
+//  (RETR, STOR, APPE, LIST, NLST, MLSD, HASH) and gives it back at its end.
+// FTP_BUF_POOL buffers are reserved for all sessions. When none is free,
+//  the buffer is allocated by malloc() for the time of the transfer.
+// With 0 (default), an idle server keeps no buffer. Reserve buffers (for
+//  example FTP_MAX_SESSIONS) when the heap is too small or fragmented to
+//  allocate one at each transfer
+#ifndef FTP_BUF_POOL
+  #define FTP_BUF_POOL 0
+#endif
+#if FTP_BUF_POOL > 32
+  #error FTP_BUF_POOL must be at most 32
+#endif
 
 
 #endif // FTP_SERVER_CONFIG_H
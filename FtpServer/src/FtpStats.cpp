@@ -0,0 +1,182 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FtpServer.h"
+
+#ifdef FTP_STATS
+
+static const char * histNames[ FtpStats::Histograms ] = {
+  "Command us", "Connect ms", "Read us", "Write us", "RETR kB/s", "STOR kB/s" };
+
+void FtpHistogram::add( uint32_t v )
+{
+  uint8_t b = 0;
+  for( uint32_t x = v; x > 0 && b < FTP_STATS_BUCKETS - 1; x >>= 1 )
+    b ++;
+  buckets[ b ] ++;
+  count ++;
+  sum += v;
+  if( v > max )
+    max = v;
+}
+
+void FtpHistogram::clear()
+{
+  count = 0;
+  max = 0;
+  sum = 0;
+  memset( buckets, 0, sizeof( buckets ));
+}
+
+// Return the upper bound of the bucket holding the pc percentile,
+//  or max if it is lower
+
+uint32_t FtpHistogram::percentile( uint8_t pc ) const
+{
+  uint32_t n = 0;
+  uint32_t rank = ( (uint64_t) count * pc + 99 ) / 100;
+  for( uint8_t b = 0; b < FTP_STATS_BUCKETS; b ++ )
+  {
+    n += buckets[ b ];
+    if( n >= rank && n > 0 )
+    {
+      uint32_t bound = b == 0 ? 0 : ( 1UL << b ) - 1;
+      return b == FTP_STATS_BUCKETS - 1 || bound > max ? max : bound;
+    }
+  }
+  return max;
+}
+
+void FtpStats::clear()
+{
+  for( uint8_t i = 0; i < Histograms; i ++ )
+    hist[ i ].clear();
+  memset( verbs, 0, sizeof( verbs ));
+  memset( errors, 0, sizeof( errors ));
+  bytesIn = 0;
+  bytesOut = 0;
+  transfers = 0;
+  aborted = 0;
+  millisBegin = millis();
+}
+
+// Count a command processed since t0 (value of clock()). The last entry of
+//  the table counts the unknown commands (key 0) and the commands that did
+//  not find room before
+
+void FtpStats::command( uint64_t key, uint32_t t0 )
+{
+  uint32_t us = micros() - t0;
+  uint8_t i = key == 0 ? FTP_STATS_VERBS - 1 : 0;
+  while( i < FTP_STATS_VERBS - 1 && verbs[ i ].key != key && verbs[ i ].count > 0 )
+    i ++;
+  if( i == FTP_STATS_VERBS - 1 )
+    key = 0;
+  verbs[ i ].key = key;
+  verbs[ i ].count ++;
+  verbs[ i ].sumUs += us;
+  if( us > verbs[ i ].maxUs )
+    verbs[ i ].maxUs = us;
+  hist[ CmdLatency ].add( us );
+}
+
+// Count a reply. Only errors (4xx and 5xx) are kept
+
+void FtpStats::reply( uint16_t code )
+{
+  if( code < 400 || code > 599 )
+    return;
+  uint8_t i = 0;
+  while( i < FTP_STATS_ERRORS - 1 && errors[ i ].code != code && errors[ i ].count > 0 )
+    i ++;
+  if( i == FTP_STATS_ERRORS - 1 )
+    code = 0;
+  errors[ i ].code = code;
+  errors[ i ].count ++;
+}
+
+// Count a transfer of bytes in ms milliseconds
+
+void FtpStats::transfer( uint8_t stage, uint32_t bytes, uint32_t ms, bool complete )
+{
+  if( stage == FTP_Store )
+    bytesIn += bytes;
+  else
+    bytesOut += bytes;
+  if( ! complete )
+  {
+    aborted ++;
+    return;
+  }
+  transfers ++;
+  if( ms > 0 && stage == FTP_Retrieve )
+    hist[ RetrRate ].add( bytes / ms );
+  else if( ms > 0 && stage == FTP_Store )
+    hist[ StorRate ].add( bytes / ms );
+}
+
+// Print statistics as lines of a multiline reply beginning with prefix
+
+void FtpStats::print( ArduinoOutStream & out, const char * prefix ) const
+{
+  out << prefix << F("Since ") << ( millis() - millisBegin ) / 1000 << F(" s: ")
+      << transfers << F(" transfers, ") << aborted << F(" aborted, ")
+      << (uint32_t) ( bytesIn >> 10 ) << F(" kB in, ")
+      << (uint32_t) ( bytesOut >> 10 ) << F(" kB out") << endl;
+  for( uint8_t i = 0; i < Histograms; i ++ )
+  {
+    const FtpHistogram & h = hist[ i ];
+    out << prefix << histNames[ i ] << F(": n=") << h.count;
+    if( h.count > 0 )
+      out << F(" avg=") << (uint32_t) ( h.sum / h.count )
+          << F(" p50=") << h.percentile( 50 ) << F(" p90=") << h.percentile( 90 )
+          << F(" p99=") << h.percentile( 99 ) << F(" max=") << h.max;
+    out << endl;
+  }
+  for( uint8_t i = 0; i < FTP_STATS_VERBS; i ++ )
+  {
+    if( verbs[ i ].count == 0 )         // the last entry can be used before the others
+      continue;
+    char name[ 9 ];
+    uint8_t l = 0;
+    for( int8_t s = 56; s >= 0; s -= 8 )
+      if(( verbs[ i ].key >> s ) & 0xff )
+        name[ l ++ ] = ( verbs[ i ].key >> s ) & 0xff;
+    name[ l ] = 0;
+    out << prefix << ( l > 0 ? name : "other" ) << F(": n=") << verbs[ i ].count
+        << F(" avg=") << verbs[ i ].sumUs / verbs[ i ].count
+        << F(" max=") << verbs[ i ].maxUs << F(" us") << endl;
+  }
+  if( errors[ 0 ].count > 0 )
+  {
+    out << prefix << F("Errors:");
+    for( uint8_t i = 0; i < FTP_STATS_ERRORS && errors[ i ].count > 0; i ++ )
+    {
+      if( errors[ i ].code > 0 )
+        out << ' ' << errors[ i ].code;
+      else
+        out << F(" other");
+      out << '=' << errors[ i ].count;
+    }
+    out << endl;
+  }
+}
+
+#endif // FTP_STATS
@@ -0,0 +1,119 @@
+/*
+ * FTP Serveur for Arduino Due, Arduino MKR
+ * and Ethernet shield W5100, W5200 or W5500
+ * ( or for Esp8266 with external SD card or SpiFfs ) **
+ * Copyright (c) 2014-2020 by Jean-Michel Gallego
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+ **                                                                            **
+ **                          RUNTIME STATISTICS                                **
+ **                                                                            **
+ *******************************************************************************/
+
+// Counters and histograms shared by all sessions, read by the sketch with
+//  FtpServer::stats() or by the client with SITE STATS.
+// Histograms count values by powers of 2: bucket 0 holds 0, bucket k holds
+//  values from 2^(k-1) to 2^k - 1, and the last bucket holds larger values.
+// Without FTP_STATS, the methods are empty and the compiler removes them,
+//  so the sessions call them without conditional compilation.
+
+#ifndef FTP_STATS_H
+#define FTP_STATS_H
+
+#define FTP_STATS_BUCKETS 24          // buckets of a histogram
+#define FTP_STATS_VERBS   32          // commands counted separately
+#define FTP_STATS_ERRORS  16          // reply codes counted separately
+
+#ifdef FTP_STATS
+
+class FtpHistogram
+{
+public:
+  void     add( uint32_t v );
+  void     clear();
+  uint32_t percentile( uint8_t pc ) const;
+
+  uint32_t count,
+           max;
+  uint64_t sum;
+  uint32_t buckets[ FTP_STATS_BUCKETS ];
+};
+
+class FtpStats
+{
+public:
+  FtpStats() { clear(); };
+
+  enum { CmdLatency = 0,              // time to process a command (us)
+         ConnectWait,                 // wait for data connection (ms)
+         ReadLatency,                 // one read of a file (us)
+         WriteLatency,                // one write of a file (us)
+         RetrRate,                    // speed of downloads (kbytes/s)
+         StorRate,                    // speed of uploads (kbytes/s)
+         Histograms };
+
+  struct Verb
+  {
+    uint64_t key;                     // command packed by ftpKey(), 0 for others
+    uint32_t count,
+             sumUs,                   // total time to process it
+             maxUs;
+  };
+
+  struct Error
+  {
+    uint16_t code;                    // reply code 4xx or 5xx, 0 for others
+    uint32_t count;
+  };
+
+  void     clear();
+  uint32_t clock() { return micros(); };
+  void     command( uint64_t key, uint32_t t0 );
+  void     reply( uint16_t code );
+  void     connect( uint32_t ms ) { hist[ ConnectWait ].add( ms ); };
+  void     read( uint32_t t0 ) { hist[ ReadLatency ].add( micros() - t0 ); };
+  void     write( uint32_t t0 ) { hist[ WriteLatency ].add( micros() - t0 ); };
+  void     transfer( uint8_t stage, uint32_t bytes, uint32_t ms, bool complete );
+  void     print( ArduinoOutStream & out, const char * prefix ) const;
+
+  FtpHistogram hist[ Histograms ];
+  Verb     verbs[ FTP_STATS_VERBS ];
+  Error    errors[ FTP_STATS_ERRORS ];
+  uint64_t bytesIn,                   // data received by STOR and APPE
+           bytesOut;                  // data sent by RETR and listings
+  uint32_t transfers,                 // transfers completed
+           aborted,                   // transfers aborted (ABOR, QUIT, lost client)
+           millisBegin;               // time of last clear()
+};
+
+#else
+
+class FtpStats
+{
+public:
+  uint32_t clock() { return 0; };
+  void     command( uint64_t key, uint32_t t0 ) {};
+  void     reply( uint16_t code ) {};
+  void     connect( uint32_t ms ) {};
+  void     read( uint32_t t0 ) {};
+  void     write( uint32_t t0 ) {};
+  void     transfer( uint8_t stage, uint32_t bytes, uint32_t ms, bool complete ) {};
+};
+
+#endif // FTP_STATS
+
+#endif // FTP_STATS_H